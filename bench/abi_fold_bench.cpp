@@ -0,0 +1,78 @@
+//////////////////////////////////////////////////////////////////////////
+// Invoking delegate_dynamic<> handles of many distinct pointer signatures,
+// as reflection code does. Build it with and without
+// FASTDELEGATE_FOLD_ABI_SIGNATURES and compare the binary sizes, the
+// program reports how many signatures shared their invokers.
+//
+// usage: abi_fold_bench [iterations]
+//////////////////////////////////////////////////////////////////////////
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+#include "delegate.h"
+#include "delegate_dynamic.h"
+//////////////////////////////////////////////////////////////////////////
+
+using namespace delegates;
+
+template<int I>
+struct Node
+{
+	Node *next;
+	long value;
+	Node() : next(0), value(I) { }
+	Node* link(Node *n, long v) { next = n; value += v; return this; }
+};
+
+typedef std::chrono::high_resolution_clock bench_clock;
+
+// One distinct signature per I
+template<int I>
+void add_handles(std::vector< std::unique_ptr<delegate_dynamic_base> > &handles, std::vector< std::unique_ptr<char[]> > &objects)
+{
+	add_handles<I - 1>(handles, objects);
+	Node<I> *n = new (new char[sizeof(Node<I>)]) Node<I>;
+	objects.push_back(std::unique_ptr<char[]>(reinterpret_cast<char*>(n)));
+	handles.push_back(std::unique_ptr<delegate_dynamic_base>(new delegate_dynamic<Node<I>* (Node<I>*, long)>(n, &Node<I>::link)));
+}
+
+template<>
+void add_handles<-1>(std::vector< std::unique_ptr<delegate_dynamic_base> > &, std::vector< std::unique_ptr<char[]> > &)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char** argv)
+{
+	size_t iterations = argc > 1 ? atoi(argv[1]) : 200000;
+
+	std::vector< std::unique_ptr<delegate_dynamic_base> > handles;
+	std::vector< std::unique_ptr<char[]> > objects;
+	add_handles<63>(handles, objects);
+
+	void *next = 0;
+	long v = 1;
+	void *ret = 0;
+	void *args[] = { &next, &v };
+
+	bench_clock::time_point start = bench_clock::now();
+	for(size_t i = 0; i != iterations; ++i)
+		for(size_t h = 0; h != handles.size(); ++h)
+			handles[h]->invoke(args, &ret);
+	double t = std::chrono::duration<double, std::nano>(bench_clock::now() - start).count();
+
+	printf("handles: %u, iterations: %u\n", unsigned(handles.size()), unsigned(iterations));
+#if defined(FASTDELEGATE_FOLD_ABI_SIGNATURES)
+	invoker_fold_stats stats = get_invoker_fold_stats();
+	printf("folding            : %u signatures share %u invokers\n", unsigned(stats.signatures), unsigned(stats.invokers));
+#else
+	printf("folding            : off (%u signatures)\n", unsigned(handles.size()));
+#endif
+	printf("delegate_dynamic   : %8.3f ns/call\n", t / (double(iterations) * handles.size()));
+
+	// keep results observable
+	return ret == 0 ? 1 : 0;
+}
@@ -0,0 +1,243 @@
+//////////////////////////////////////////////////////////////////////////
+// Call cost of delegates compared to raw function pointers, virtual calls
+// and std::function, for 0..5 int arguments (delegate_target is a static
+// function bound as a compile-time target, delegate_virtual a virtual
+// method, resolved at bind time with FASTDELEGATE_RESOLVE_VIRTUALS,
+// weak_delegate checks the generation of its target first):
+//		latency		every call depends on the result of the previous one
+//		throughput	independent calls
+// plus the cost of copying, comparing and binding the callable objects.
+//
+// Results are printed as a table, --json writes them machine-readable
+// for tracking regressions (one record per arity / variant / metric).
+//
+// usage: call_bench [--iterations N] [--json FILE]
+//////////////////////////////////////////////////////////////////////////
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+#include "delegate.h"
+#include "delegate_dynamic.h"
+#include "delegate_weak.h"
+//////////////////////////////////////////////////////////////////////////
+
+using namespace delegates;
+
+// Hides a value from the optimizer, so calls through it aren't inlined or
+// devirtualized and results aren't thrown away
+template<class T>
+inline void opaque(T &v)
+{
+#if defined(__GNUC__)
+	asm volatile("" : : "r"(&v) : "memory");
+#else
+	static T* volatile sink;
+	sink = &v;
+#endif
+}
+
+template<size_t... I> struct seq { };
+template<size_t N, size_t... I> struct make_seq : make_seq<N - 1, N - 1, I...> { };
+template<size_t... I> struct make_seq<0, I...> { typedef seq<I...> type; };
+
+template<size_t I> struct int_arg { typedef int type; };
+
+inline int sum() { return 0; }
+template<class... A> inline int sum(int a, A... rest) { return a + sum(rest...); }
+
+struct result
+{
+	unsigned arity;
+	std::string variant;
+	std::string metric;
+	double ns;
+};
+
+typedef std::chrono::high_resolution_clock bench_clock;
+
+template<class Fn>
+double measure(size_t iterations, Fn fn)
+{
+	bench_clock::time_point start = bench_clock::now();
+	for(size_t i = 0; i != iterations; ++i)
+		fn(static_cast<int>(i));
+	return std::chrono::duration<double, std::nano>(bench_clock::now() - start).count() / iterations;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+template<class Seq> struct arity_bench;
+
+template<size_t... I>
+struct arity_bench< seq<I...> >
+{
+	typedef int signature (typename int_arg<I>::type...);
+
+	FASTDLGT_NOINLINE static int static_fn(typename int_arg<I>::type... a) { return sum(a...) + 1; }
+
+	struct Obj : weak_target
+	{
+		int base;
+		FASTDLGT_NOINLINE int member_fn(typename int_arg<I>::type... a) { return sum(a...) + base; }
+	};
+
+	struct Base
+	{
+		virtual ~Base() { }
+		virtual int virtual_fn(typename int_arg<I>::type... a) = 0;
+	};
+
+	struct Derived : Base
+	{
+		int base;
+		FASTDLGT_NOINLINE virtual int virtual_fn(typename int_arg<I>::type... a) { return sum(a...) + base; }
+	};
+
+	// Latency chains the result into every argument (and into the sum
+	// for the parameterless signature), throughput passes the loop counter
+	template<class F>
+	static void call(std::vector<result> &out, size_t iterations, const char *variant, F f)
+	{
+		int x = 1, acc = 0;
+		double latency = measure(iterations, [&](int) { x += f(((void)I, x)...); });
+		double throughput = measure(iterations, [&](int i) { acc += f(((void)I, i)...); });
+		opaque(x);
+		opaque(acc);
+		result r1 = { unsigned(sizeof...(I)), variant, "latency", latency };
+		result r2 = { unsigned(sizeof...(I)), variant, "throughput", throughput };
+		out.push_back(r1);
+		out.push_back(r2);
+	}
+
+	static void add(std::vector<result> &out, const char *variant, const char *metric, double ns)
+	{
+		result r = { unsigned(sizeof...(I)), variant, metric, ns };
+		out.push_back(r);
+	}
+
+	static void run(std::vector<result> &out, size_t iterations)
+	{
+		Obj obj;
+		obj.base = 1;
+		Derived derived;
+		derived.base = 1;
+		Base *virt = &derived;
+		opaque(virt);
+
+		signature *fn = &static_fn;
+		opaque(fn);
+
+		std::function<signature> std_fn(fn);
+		delegate<signature> d_static(&static_fn);
+		delegate<signature> d_member(&obj, &Obj::member_fn);
+		delegate<signature> d_virtual(virt, &Base::virtual_fn);
+		delegate<signature> d_target;
+		d_target.template bind<&static_fn>();
+		weak_delegate<signature> d_weak(&obj, &Obj::member_fn);
+		delegate_dynamic<signature> d_dynamic(&obj, &Obj::member_fn);
+		delegate_dynamic_base *dyn = &d_dynamic;
+		opaque(d_static);
+		opaque(d_member);
+		opaque(d_virtual);
+		opaque(d_target);
+		opaque(d_weak);
+		opaque(dyn);
+
+		call(out, iterations, "function_ptr", [&](typename int_arg<I>::type... a) { return fn(a...); });
+		call(out, iterations, "virtual", [&](typename int_arg<I>::type... a) { return virt->virtual_fn(a...); });
+		call(out, iterations, "std_function", [&](typename int_arg<I>::type... a) { return std_fn(a...); });
+		call(out, iterations, "delegate_static", [&](typename int_arg<I>::type... a) { return d_static(a...); });
+		call(out, iterations, "delegate_member", [&](typename int_arg<I>::type... a) { return d_member(a...); });
+		call(out, iterations, "delegate_virtual", [&](typename int_arg<I>::type... a) { return d_virtual(a...); });
+		call(out, iterations, "weak_delegate", [&](typename int_arg<I>::type... a) { return d_weak(a...); });
+		call(out, iterations, "delegate_target", [&](typename int_arg<I>::type... a) { return d_target(a...); });
+		call(out, iterations, "delegate_dynamic", [&](typename int_arg<I>::type... a) {
+			void *args[] = { &a..., 0 };
+			int ret;
+			dyn->invoke(args, &ret);
+			return ret;
+		});
+
+		// Object costs
+		delegate<signature> d_copies[16];
+		std::function<signature> f_copies[16];
+		add(out, "delegate_member", "copy", measure(iterations, [&](int i) { d_copies[i & 15] = d_member; opaque(d_copies); }));
+		add(out, "std_function", "copy", measure(iterations, [&](int i) { f_copies[i & 15] = std_fn; opaque(f_copies); }));
+
+		delegate<signature> other(&obj, &Obj::member_fn);
+		opaque(other);
+		int equal = 0;
+		add(out, "delegate_member", "compare", measure(iterations, [&](int) { equal += d_member == other; opaque(other); }));
+		opaque(equal);
+
+		Obj *target = &obj;
+		add(out, "delegate_member", "bind", measure(iterations, [&](int) { d_copies[0].bind(target, &Obj::member_fn); opaque(d_copies); }));
+		add(out, "std_function", "bind", measure(iterations, [&](int) {
+			f_copies[0] = [target](typename int_arg<I>::type... a) { return target->member_fn(a...); };
+			opaque(f_copies);
+		}));
+	}
+};
+
+template<size_t N>
+void run_arity(std::vector<result> &out, size_t iterations)
+{
+	arity_bench<typename make_seq<N>::type>::run(out, iterations);
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+static bool write_json(const char *path, const std::vector<result> &results, size_t iterations)
+{
+	FILE *f = fopen(path, "w");
+	if(!f)
+		return false;
+	fprintf(f, "{\n  \"benchmark\": \"call_bench\",\n  \"iterations\": %u,\n  \"unit\": \"ns\",\n  \"results\": [\n", unsigned(iterations));
+	for(size_t i = 0; i != results.size(); ++i)
+		fprintf(f, "    {\"arity\": %u, \"variant\": \"%s\", \"metric\": \"%s\", \"ns\": %.4f}%s\n",
+			results[i].arity, results[i].variant.c_str(), results[i].metric.c_str(), results[i].ns, i + 1 != results.size() ? "," : "");
+	fprintf(f, "  ]\n}\n");
+	return fclose(f) == 0;
+}
+
+int main(int argc, char** argv)
+{
+	size_t iterations = 10000000;
+	const char *json = 0;
+	for(int i = 1; i < argc; ++i)
+	{
+		if(!strcmp(argv[i], "--iterations") && i + 1 < argc)
+			iterations = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "--json") && i + 1 < argc)
+			json = argv[++i];
+		else
+		{
+			fprintf(stderr, "usage: %s [--iterations N] [--json FILE]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	std::vector<result> results;
+	run_arity<0>(results, iterations);
+	run_arity<1>(results, iterations);
+	run_arity<2>(results, iterations);
+	run_arity<3>(results, iterations);
+	run_arity<4>(results, iterations);
+	run_arity<5>(results, iterations);
+
+	printf("iterations: %u, ns/op\n", unsigned(iterations));
+	printf("%5s  %-18s %-12s %8s\n", "arity", "variant", "metric", "ns");
+	for(size_t i = 0; i != results.size(); ++i)
+		printf("%5u  %-18s %-12s %8.3f\n", results[i].arity, results[i].variant.c_str(), results[i].metric.c_str(), results[i].ns);
+
+	if(json && !write_json(json, results, iterations))
+	{
+		fprintf(stderr, "can't write %s\n", json);
+		return 1;
+	}
+	return 0;
+}
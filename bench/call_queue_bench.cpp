@@ -0,0 +1,106 @@
+//////////////////////////////////////////////////////////////////////////
+// Posting calls from worker threads to one consumer thread: call_queue
+// compared to std::deque< std::function<> > guarded by a mutex
+//
+// usage: call_queue_bench [producers] [calls per producer]
+//////////////////////////////////////////////////////////////////////////
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "delegate.h"
+#include "delegate_queue.h"
+//////////////////////////////////////////////////////////////////////////
+
+using namespace delegates;
+
+struct Sink
+{
+	long long sum;
+	Sink() : sum(0) { }
+	void on_value(int a, double b) { sum += a + static_cast<long long>(b); }
+};
+
+struct locked_queue
+{
+	std::mutex lock;
+	std::deque< std::function<void ()> > calls;
+
+	void post(Sink *s, int a, double b)
+	{
+		std::lock_guard<std::mutex> l(lock);
+		calls.push_back([s, a, b] { s->on_value(a, b); });
+	}
+
+	size_t drain()
+	{
+		std::deque< std::function<void ()> > batch;
+		{
+			std::lock_guard<std::mutex> l(lock);
+			batch.swap(calls);
+		}
+		for(size_t i = 0; i != batch.size(); ++i)
+			batch[i]();
+		return batch.size();
+	}
+};
+
+typedef std::chrono::high_resolution_clock bench_clock;
+
+template<class Post, class Drain>
+double run(size_t producers, size_t calls, Post post, Drain drain)
+{
+	bench_clock::time_point start = bench_clock::now();
+	std::vector<std::thread> threads;
+	for(size_t p = 0; p != producers; ++p)
+		threads.push_back(std::thread([&, p] {
+			for(size_t i = 0; i != calls; ++i)
+				post(int(i), double(p));
+		}));
+
+	size_t total = producers * calls, done = 0;
+	while(done != total)
+	{
+		size_t n = drain();
+		done += n;
+		if(n == 0)
+			std::this_thread::yield();
+	}
+
+	for(size_t t = 0; t != threads.size(); ++t)
+		threads[t].join();
+	return total / std::chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char** argv)
+{
+	size_t producers = argc > 1 ? atoi(argv[1]) : 4;
+	size_t calls = argc > 2 ? atoi(argv[2]) : 1000000;
+
+	Sink sink;
+	locked_queue locked;
+	call_queue<> queue(4096);
+	delegate<void (int, double)> d(&sink, &Sink::on_value);
+
+	double t_locked = run(producers, calls,
+		[&](int a, double b) { locked.post(&sink, a, b); },
+		[&] { return locked.drain(); });
+
+	double t_queue = run(producers, calls,
+		[&](int a, double b) { queue.post(d, a, b); },
+		[&] { return queue.drain(); });
+
+	printf("producers: %u, calls per producer: %u\n", unsigned(producers), unsigned(calls));
+	printf("mutex + deque<function> : %12.0f calls/s\n", t_locked);
+	printf("call_queue              : %12.0f calls/s\n", t_queue);
+
+	// keep results observable
+	return sink.sum == 42 ? 1 : 0;
+}
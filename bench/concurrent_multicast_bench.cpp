@@ -0,0 +1,110 @@
+//////////////////////////////////////////////////////////////////////////
+// Multi-threaded firing throughput of concurrent_multicast_delegate
+// compared to multicast_delegate guarded by a mutex.
+//
+// Every configuration runs N firing threads plus one thread that keeps
+// subscribing and unsubscribing a handler.
+//
+// usage: concurrent_multicast_bench [max_threads] [milliseconds]
+//////////////////////////////////////////////////////////////////////////
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "delegate.h"
+#include "delegate_concurrent.h"
+//////////////////////////////////////////////////////////////////////////
+
+using namespace delegates;
+
+// Handlers only touch thread-local data, so the measured scaling is
+// the one of the event itself
+thread_local long t_sink = 0;
+
+struct Listener
+{
+	long id;
+	char padding[56];
+	Listener() : id(0) { }
+	void on_value(int v) { t_sink += v + id; }
+};
+
+// multicast_delegate with a mutex around every operation, the usual workaround
+struct locked_multicast
+{
+	multicast_delegate<void (int)> ev;
+	mutable std::mutex lock;
+
+	void add(const multicast_delegate<void (int)>::delegate_type &d) { std::lock_guard<std::mutex> l(lock); ev.add(d); }
+	void remove(const multicast_delegate<void (int)>::delegate_type &d) { std::lock_guard<std::mutex> l(lock); ev.remove(d); }
+	void operator() (int v) const { std::lock_guard<std::mutex> l(lock); ev(v); }
+};
+
+template<class Event>
+double run(Event &ev, std::vector<Listener> &listeners, size_t threads, int ms)
+{
+	std::atomic<bool> stop(false);
+	std::vector<long> fired(threads * 8); // spaced to avoid false sharing
+
+	std::thread writer([&] {
+		Listener &extra = listeners.back();
+		while(!stop)
+		{
+			ev.add(make_delegate(&extra, &Listener::on_value));
+			ev.remove(make_delegate(&extra, &Listener::on_value));
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+	});
+
+	std::vector<std::thread> pool;
+	for(size_t t = 0; t != threads; ++t)
+		pool.push_back(std::thread([&, t] {
+			long n = 0;
+			while(!stop) { ev(1); ++n; }
+			fired[t * 8] = n;
+		}));
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+	stop = true;
+	writer.join();
+	for(size_t t = 0; t != pool.size(); ++t)
+		pool[t].join();
+
+	long total = 0;
+	for(size_t t = 0; t != threads; ++t)
+		total += fired[t * 8];
+	return total / (ms / 1000.0);
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char** argv)
+{
+	size_t max_threads = argc > 1 ? atoi(argv[1]) : std::thread::hardware_concurrency();
+	int ms = argc > 2 ? atoi(argv[2]) : 500;
+	if(max_threads == 0)
+		max_threads = 4;
+
+	const size_t subscribers = 8;
+	std::vector<Listener> listeners(subscribers + 1);
+
+	printf("%8s %20s %20s\n", "threads", "mutex fires/s", "concurrent fires/s");
+	for(size_t threads = 1; threads <= max_threads; threads *= 2)
+	{
+		locked_multicast locked;
+		concurrent_multicast_delegate<void (int)> concurrent;
+		for(size_t i = 0; i != subscribers; ++i)
+		{
+			locked.add(make_delegate(&listeners[i], &Listener::on_value));
+			concurrent.add(make_delegate(&listeners[i], &Listener::on_value));
+		}
+
+		double t_locked = run(locked, listeners, threads, ms);
+		double t_concurrent = run(concurrent, listeners, threads, ms);
+		printf("%8u %20.0f %20.0f\n", unsigned(threads), t_locked, t_concurrent);
+	}
+	return 0;
+}
@@ -0,0 +1,89 @@
+//////////////////////////////////////////////////////////////////////////
+// "Is this handler registered" lookups: std::set< delegate<> > compared to
+// std::unordered_set and delegate_hash_set.
+//
+// Half of the lookups hit, half miss.
+//
+// usage: delegate_map_bench [handlers] [iterations]
+//////////////////////////////////////////////////////////////////////////
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <set>
+#include <unordered_set>
+#include <vector>
+#include "delegate.h"
+#include "delegate_flat_map.h"
+//////////////////////////////////////////////////////////////////////////
+
+using namespace delegates;
+
+struct Listener
+{
+	int sum;
+	Listener() : sum(0) { }
+	void on_value(int v) { sum += v; }
+	void on_other(int v) { sum -= v; }
+};
+
+typedef delegate<void (int)> handler;
+typedef std::chrono::high_resolution_clock bench_clock;
+
+template<class Fn>
+double measure(size_t iterations, Fn fn)
+{
+	bench_clock::time_point start = bench_clock::now();
+	for(size_t i = 0; i != iterations; ++i)
+		fn();
+	return std::chrono::duration<double, std::nano>(bench_clock::now() - start).count();
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char** argv)
+{
+	size_t handlers = argc > 1 ? atoi(argv[1]) : 1000;
+	size_t iterations = argc > 2 ? atoi(argv[2]) : 2000;
+
+	std::vector<Listener> objects(handlers);
+	std::vector<handler> probes;
+
+	std::set<handler> tree;
+	std::unordered_set<handler> unordered;
+	delegate_hash_set<handler> flat;
+
+	for(size_t i = 0; i != handlers; ++i)
+	{
+		handler d(&objects[i], &Listener::on_value);
+		tree.insert(d);
+		unordered.insert(d);
+		flat.insert(d);
+		probes.push_back(d);
+		probes.push_back(handler(&objects[i], &Listener::on_other));
+	}
+
+	size_t found = 0;
+	double t_tree = measure(iterations, [&] {
+		for(size_t i = 0; i != probes.size(); ++i)
+			found += tree.count(probes[i]);
+	});
+
+	double t_unordered = measure(iterations, [&] {
+		for(size_t i = 0; i != probes.size(); ++i)
+			found += unordered.count(probes[i]);
+	});
+
+	double t_flat = measure(iterations, [&] {
+		for(size_t i = 0; i != probes.size(); ++i)
+			found += flat.contains(probes[i]);
+	});
+
+	double lookups = double(probes.size()) * iterations;
+	printf("handlers: %u, iterations: %u\n", unsigned(handlers), unsigned(iterations));
+	printf("std::set           : %8.3f ns/lookup\n", t_tree / lookups);
+	printf("std::unordered_set : %8.3f ns/lookup\n", t_unordered / lookups);
+	printf("delegate_hash_set  : %8.3f ns/lookup\n", t_flat / lookups);
+
+	// keep results observable
+	return found == 42 ? 1 : 0;
+}
@@ -0,0 +1,127 @@
+//////////////////////////////////////////////////////////////////////////
+// Cost of invoke(void** args, void* ret) through delegate_dynamic_base
+// (virtual call) compared to the vtable-free delegate_any handle, and of
+// one handle called per record compared to invoke_batch()
+//
+// usage: dynamic_invoke_bench [handles] [iterations]
+//////////////////////////////////////////////////////////////////////////
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+#include "delegate.h"
+#include "delegate_dynamic.h"
+//////////////////////////////////////////////////////////////////////////
+
+using namespace delegates;
+
+struct Record
+{
+	int sum;
+	char padding[60];
+	Record() : sum(0) { }
+	int add(int v) { return sum += v; }
+	int add_ref(const int &v) { return sum += v; }
+};
+
+typedef std::chrono::high_resolution_clock bench_clock;
+
+template<class Fn>
+double measure(size_t iterations, Fn fn)
+{
+	bench_clock::time_point start = bench_clock::now();
+	for(size_t i = 0; i != iterations; ++i)
+		fn(static_cast<int>(i));
+	return std::chrono::duration<double, std::nano>(bench_clock::now() - start).count();
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char** argv)
+{
+	size_t handles = argc > 1 ? atoi(argv[1]) : 1000;
+	size_t iterations = argc > 2 ? atoi(argv[2]) : 20000;
+
+	std::vector<Record> objects(handles);
+	std::vector< std::unique_ptr<delegate_dynamic_base> > virt;
+	std::vector<delegate_any> any;
+
+	// two signatures, as in a reflection table, so the compiler can't devirtualize
+	for(size_t i = 0; i != handles; ++i)
+	{
+		if(i % 2)
+		{
+			virt.push_back(std::unique_ptr<delegate_dynamic_base>(new delegate_dynamic<int (int)>(&objects[i], &Record::add)));
+			any.push_back(delegate_any(&objects[i], &Record::add));
+		}
+		else
+		{
+			virt.push_back(std::unique_ptr<delegate_dynamic_base>(new delegate_dynamic<int (const int&)>(&objects[i], &Record::add_ref)));
+			any.push_back(delegate_any(&objects[i], &Record::add_ref));
+		}
+	}
+
+	long long check = 0;
+
+	double t_virt = measure(iterations, [&](int v) {
+		int ret;
+		void* args[] = { &v };
+		for(size_t i = 0; i != virt.size(); ++i)
+		{
+			virt[i]->invoke(args, &ret);
+			check += ret;
+		}
+	});
+
+	double t_any = measure(iterations, [&](int v) {
+		int ret;
+		void* args[] = { &v };
+		for(size_t i = 0; i != any.size(); ++i)
+		{
+			any[i].invoke(args, &ret);
+			check += ret;
+		}
+	});
+
+	// one handle, 'handles' records
+	std::vector<int> values(handles), results(handles);
+	std::vector<void*> arg_storage(handles);
+	std::vector<void**> rows(handles);
+	for(size_t i = 0; i != handles; ++i)
+	{
+		values[i] = int(i);
+		arg_storage[i] = &values[i];
+		rows[i] = &arg_storage[i];
+	}
+	const delegate_dynamic_base &one = *virt[0];
+
+	double t_single = measure(iterations, [&](int) {
+		for(size_t i = 0; i != handles; ++i)
+			one.invoke(rows[i], &results[i]);
+		check += results[0];
+	});
+
+	double t_rows = measure(iterations, [&](int) {
+		one.invoke_batch(&rows[0], &results[0], sizeof(int), handles);
+		check += results[0];
+	});
+
+	void* bases[] = { &values[0] };
+	size_t strides[] = { sizeof(int) };
+	double t_cols = measure(iterations, [&](int) {
+		one.invoke_batch_columns(bases, strides, &results[0], sizeof(int), handles);
+		check += results[0];
+	});
+
+	double calls = double(handles) * iterations;
+	printf("handles: %u, iterations: %u\n", unsigned(handles), unsigned(iterations));
+	printf("delegate_dynamic_base : %8.3f ns/call\n", t_virt / calls);
+	printf("delegate_any          : %8.3f ns/call\n", t_any / calls);
+	printf("invoke per record     : %8.3f ns/call\n", t_single / calls);
+	printf("invoke_batch          : %8.3f ns/call\n", t_rows / calls);
+	printf("invoke_batch_columns  : %8.3f ns/call\n", t_cols / calls);
+
+	// keep results observable
+	return check == 42 ? 1 : 0;
+}
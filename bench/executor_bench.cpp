@@ -0,0 +1,125 @@
+//////////////////////////////////////////////////////////////////////////
+// Throughput of tiny tasks on delegate_executor compared to std::async
+//
+// usage: executor_bench [tasks] [threads]
+//////////////////////////////////////////////////////////////////////////
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <future>
+#include <thread>
+#include <vector>
+#include "delegate.h"
+#include "delegate_executor.h"
+//////////////////////////////////////////////////////////////////////////
+
+using namespace delegates;
+
+int square(int v) { return v * v; }
+
+// Splits itself into two subtasks until depth is 0, all submitted from workers
+struct Splitter
+{
+	delegate_executor *pool;
+	std::atomic<long> leaves;
+	Splitter(delegate_executor *p) : pool(p), leaves(0) { }
+
+	void split(int depth)
+	{
+		if(depth == 0) { leaves.fetch_add(1, std::memory_order_relaxed); return; }
+		delegate<void (int)> self(this, &Splitter::split);
+		pool->submit(self, depth - 1);
+		pool->submit(self, depth - 1);
+	}
+};
+
+typedef std::chrono::high_resolution_clock bench_clock;
+
+double seconds_since(bench_clock::time_point start)
+{
+	return std::chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char** argv)
+{
+	size_t tasks = argc > 1 ? atoi(argv[1]) : 2000000;
+	size_t threads = argc > 2 ? atoi(argv[2]) : 0;
+
+	delegate_executor pool(threads);
+	delegate<int (int)> d(&square);
+	long long check = 0;
+
+	// submit everything from the main thread, then collect the futures
+	bench_clock::time_point start = bench_clock::now();
+	{
+		std::vector< task_future<int> > futures;
+		futures.reserve(tasks);
+		for(size_t i = 0; i != tasks; ++i)
+			futures.push_back(pool.submit(d, int(i & 1023)));
+		for(size_t i = 0; i != tasks; ++i)
+			check += futures[i].get();
+	}
+	double t_futures = seconds_since(start);
+
+	// fire and forget
+	start = bench_clock::now();
+	for(size_t i = 0; i != tasks; ++i)
+		pool.submit(d, int(i & 1023));
+	pool.wait_idle();
+	double t_detached = seconds_since(start);
+
+	// tasks spawned by tasks, stolen by idle workers
+	int depth = 0;
+	while((size_t(2) << depth) <= tasks)
+		++depth;
+	Splitter splitter(&pool);
+	start = bench_clock::now();
+	pool.submit(delegate<void (int)>(&splitter, &Splitter::split), depth);
+	pool.wait_idle();
+	double t_nested = seconds_since(start);
+	size_t nested_tasks = (size_t(2) << depth) - 1;
+
+	// one submitting thread per worker, all contending for the inboxes
+	start = bench_clock::now();
+	{
+		std::vector<std::thread> submitters;
+		for(size_t t = 0; t != pool.size(); ++t)
+			submitters.push_back(std::thread([&pool, &d, tasks, t] {
+				for(size_t i = t; i < tasks; i += pool.size())
+					pool.submit(d, int(i & 1023));
+			}));
+		for(size_t t = 0; t != submitters.size(); ++t)
+			submitters[t].join();
+	}
+	pool.wait_idle();
+	double t_contended = seconds_since(start);
+
+	// std::async starts a thread per task, so run fewer of them, 256 in flight
+	size_t async_tasks = tasks / 20;
+	start = bench_clock::now();
+	{
+		std::vector< std::future<int> > futures;
+		for(size_t i = 0; i < async_tasks; i += 256)
+		{
+			futures.clear();
+			for(size_t j = i; j != async_tasks && j != i + 256; ++j)
+				futures.push_back(std::async(std::launch::async, &square, int(j & 1023)));
+			for(size_t j = 0; j != futures.size(); ++j)
+				check += futures[j].get();
+		}
+	}
+	double t_async = seconds_since(start);
+
+	printf("threads: %u, tasks: %u\n", unsigned(pool.size()), unsigned(tasks));
+	printf("submit + future.get : %12.0f tasks/s\n", tasks / t_futures);
+	printf("submit, wait_idle   : %12.0f tasks/s\n", tasks / t_detached);
+	printf("nested submit       : %12.0f tasks/s\n", nested_tasks / t_nested);
+	printf("concurrent submit   : %12.0f tasks/s\n", tasks / t_contended);
+	printf("std::async          : %12.0f tasks/s\n", async_tasks / t_async);
+
+	// keep results observable
+	return check == 42 ? 1 : 0;
+}
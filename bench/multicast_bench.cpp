@@ -0,0 +1,81 @@
+//////////////////////////////////////////////////////////////////////////
+// Firing cost of multicast_delegate compared to std::vector< delegate<> >
+//
+// usage: multicast_bench [listeners] [iterations]
+//////////////////////////////////////////////////////////////////////////
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "delegate.h"
+#include "delegate_multicast.h"
+//////////////////////////////////////////////////////////////////////////
+
+using namespace delegates;
+
+struct Listener
+{
+	int sum;
+	char padding[60]; // one listener per cache line, as in real objects
+	Listener() : sum(0) { }
+	void on_value(int v) { sum += v; }
+};
+
+int g_static_sum = 0;
+void on_value_static(int v) { g_static_sum += v; }
+
+typedef std::chrono::high_resolution_clock bench_clock;
+
+template<class Fn>
+double measure(size_t iterations, Fn fn)
+{
+	bench_clock::time_point start = bench_clock::now();
+	for(size_t i = 0; i != iterations; ++i)
+		fn(static_cast<int>(i));
+	return std::chrono::duration<double, std::nano>(bench_clock::now() - start).count();
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char** argv)
+{
+	size_t listeners = argc > 1 ? atoi(argv[1]) : 1000;
+	size_t iterations = argc > 2 ? atoi(argv[2]) : 20000;
+
+	std::vector<Listener> objects(listeners);
+
+	std::vector< delegate<void (int)> > vec;
+	multicast_delegate<void (int)> mc;
+
+	for(size_t i = 0; i != listeners; ++i)
+	{
+		delegate<void (int)> d;
+		if(i % 8 == 0)
+			d.bind(&on_value_static);
+		else
+			d.bind(&objects[i], &Listener::on_value);
+
+		vec.push_back(d);
+		mc += d;
+	}
+
+	double t_vec = measure(iterations, [&](int v) {
+		for(size_t i = 0; i != vec.size(); ++i)
+			vec[i](v);
+	});
+
+	double t_mc = measure(iterations, [&](int v) {
+		mc(v);
+	});
+
+	double calls = double(listeners) * iterations;
+	printf("listeners: %u, iterations: %u\n", unsigned(listeners), unsigned(iterations));
+	printf("vector<delegate>   : %8.3f ns/call\n", t_vec / calls);
+	printf("multicast_delegate : %8.3f ns/call\n", t_mc / calls);
+
+	// keep results observable
+	long long check = g_static_sum;
+	for(size_t i = 0; i != objects.size(); ++i)
+		check += objects[i].sum;
+	return check == 42 ? 1 : 0;
+}
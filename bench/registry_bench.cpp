@@ -0,0 +1,87 @@
+//////////////////////////////////////////////////////////////////////////
+// Name lookup of reflected methods: std::unordered_map<std::string, ...>
+// compared to method_registry with and without a call site method_cache.
+//
+// usage: registry_bench [methods] [iterations]
+//////////////////////////////////////////////////////////////////////////
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "delegate.h"
+#include "delegate_dynamic.h"
+#include "delegate_registry.h"
+//////////////////////////////////////////////////////////////////////////
+
+using namespace delegates;
+
+struct Widget
+{
+	int value;
+	Widget() : value(0) { }
+	void set_value(int v) { value += v; }
+};
+
+typedef std::chrono::high_resolution_clock bench_clock;
+
+template<class Fn>
+double measure(size_t iterations, Fn fn)
+{
+	bench_clock::time_point start = bench_clock::now();
+	for(size_t i = 0; i != iterations; ++i)
+		fn(static_cast<int>(i));
+	return std::chrono::duration<double, std::nano>(bench_clock::now() - start).count();
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char** argv)
+{
+	size_t methods = argc > 1 ? atoi(argv[1]) : 64;
+	size_t iterations = argc > 2 ? atoi(argv[2]) : 5000000;
+
+	Widget w;
+	std::vector< delegate_dynamic<void (int)> > handles(methods, delegate_dynamic<void (int)>(&w, &Widget::set_value));
+
+	std::unordered_map<std::string, delegate_dynamic_base*> map;
+	method_registry registry;
+	for(size_t i = 0; i != methods; ++i)
+	{
+		std::string name = "property_" + std::to_string(i);
+		map[name] = &handles[i];
+		registry.add(name, &handles[i]);
+	}
+	registry.add("SetValue", &handles[0]);
+	map["SetValue"] = &handles[0];
+
+	bench_clock::time_point start = bench_clock::now();
+	registry.build();
+	double t_build = std::chrono::duration<double, std::micro>(bench_clock::now() - start).count();
+
+	// The usual call site: a name literal, converted to std::string for the map
+	double t_map = measure(iterations, [&](int v) {
+		void *args[] = { &v };
+		map.find("SetValue")->second->invoke(args, 0);
+	});
+
+	double t_registry = measure(iterations, [&](int v) {
+		void *args[] = { &v };
+		registry.find("SetValue")->invoke(args, 0);
+	});
+
+	double t_cached = measure(iterations, [&](int v) {
+		static method_cache cache;
+		void *args[] = { &v };
+		registry.invoke(cache, "SetValue", args, 0);
+	});
+
+	printf("methods: %u, iterations: %u, build: %.1f us\n", unsigned(methods + 1), unsigned(iterations), t_build);
+	printf("unordered_map<string>   : %8.3f ns/call\n", t_map / iterations);
+	printf("method_registry         : %8.3f ns/call\n", t_registry / iterations);
+	printf("method_registry + cache : %8.3f ns/call\n", t_cached / iterations);
+
+	// keep results observable
+	return w.value == 42 ? 1 : 0;
+}
@@ -1,15 +1,25 @@
 #ifndef _SF_DELEGATE_H__
 #define _SF_DELEGATE_H__
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
 namespace delegates
 {
 
 #include "delegate_config.h"
 #include "delegate_utils.h"
 #include "delegate_closure.h"
+#include "delegate_stats.h"
 #include "delegate_delegn.h"
 
-// Generate function-style delegate for zero-overhead and dynamic versions of delegates
+// Generate numbered aliases for zero-overhead and dynamic versions of delegates
 #define FS_DELEGATE delegate
 #define DELEGATE(n) delegate##n
 #	include "delegate_funcstyle.h"
@@ -18,14 +28,14 @@ namespace delegates
 
 // Generate both const and non-const versions of ordinary zero-overhead delegate makers
 #define DELEG_CONST
-#define DELEGATE(n) delegate##n
+#define FS_DELEGATE delegate
 #define MAKE_DELEGATE make_delegate
 #	include "delegate_makedeleg.h"
 #undef DELEG_CONST
 #define DELEG_CONST const
 #	include "delegate_makedeleg.h"
 #undef MAKE_DELEGATE
-#undef DELEGATE
+#undef FS_DELEGATE
 #undef DELEG_CONST
 
 template<class FT>
@@ -33,6 +43,33 @@ delegate<FT> make_delegate(FT* f) {
 	return delegate<FT>(f);
 }
 
+// Binds a functor with a single non-template operator(), the delegate doesn't own it
+template<class F>
+delegate<typename detail::functor_signature<F>::type> make_delegate(F& f) {
+	return delegate<typename detail::functor_signature<F>::type>(f);
+}
+
+#if defined(FASTDLGT_HAS_AUTO_TEMPLATE_PARAMS)
+// Compile-time targets, see delegate<>::bind<Target>():
+//		auto d1 = make_delegate<&F1>();
+//		auto d2 = make_delegate<&Obj::SetValue>(&obj);
+template<auto Target>
+delegate<typename detail::target_traits<decltype(Target)>::type> make_delegate() {
+	delegate<typename detail::target_traits<decltype(Target)>::type> d;
+	d.template bind<Target>();
+	return d;
+}
+
+template<auto Target, class Y>
+delegate<typename detail::target_traits<decltype(Target)>::type> make_delegate(Y *pthis) {
+	delegate<typename detail::target_traits<decltype(Target)>::type> d;
+	d.template bind<typename detail::target_traits<decltype(Target)>::class_type, Target>(pthis);
+	return d;
 }
+#endif
+
+}
+
+#include "delegate_hash.h"
 
 #endif //_SF_DELEGATE_H__
\ No newline at end of file
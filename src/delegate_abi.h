@@ -0,0 +1,175 @@
+#ifndef _DELEGATE_ABI_H__
+#define _DELEGATE_ABI_H__
+
+#include "delegate_signature.h"
+
+//////////////////////////////////////////////////////////////////////////
+// ABI classes of signatures
+//////////////////////////////////////////////////////////////////////////
+
+// Many signatures are passed identically by the calling convention: every
+// object pointer is a pointer-sized value, every reference is passed as the
+// address of the object, int and an enum based on int are the same 32-bit
+// integer. abi_signature<> maps a signature to a canonical representative of
+// its class:
+//		T* (object pointers)			void*
+//		T&, T&&							char&, char&&
+//		integers and enums (not bool)	same-sized integer of the same signedness
+// Everything else (bool, floating point, class types, function and member
+// pointers) is kept. Return types are only folded when they are integers,
+// enums or object pointers. The result is stored through the return type,
+// so a returned reference keeps the type it refers to.
+//
+// With FASTDELEGATE_FOLD_ABI_SIGNATURES the dynamic layer calls every closure
+// through the delegate of the canonical signature, so all signatures of one
+// class share a single set of unpacking thunks. delegate_dynamic<> still has
+// a virtual table per signature, but its functions shrink to forwarding calls.
+// Calling a function through an ABI-equivalent signature is formally undefined
+// behaviour, like the closure conversions of the library itself, which is why
+// the mode is opt-in. It is meant for reflection-heavy code with thousands of
+// bound methods, get_invoker_fold_stats() tells how many thunks were saved.
+
+namespace detail
+{
+	template<size_t Size, bool Signed> struct abi_int { };
+	template<> struct abi_int<1, true> { typedef int8_t type; };
+	template<> struct abi_int<1, false> { typedef uint8_t type; };
+	template<> struct abi_int<2, true> { typedef int16_t type; };
+	template<> struct abi_int<2, false> { typedef uint16_t type; };
+	template<> struct abi_int<4, true> { typedef int32_t type; };
+	template<> struct abi_int<4, false> { typedef uint32_t type; };
+	template<> struct abi_int<8, true> { typedef int64_t type; };
+	template<> struct abi_int<8, false> { typedef uint64_t type; };
+
+	template<class T, bool IsEnum = std::is_enum<T>::value>
+	struct abi_signed : std::is_signed<T> { };
+
+	template<class T>
+	struct abi_signed<T, true> : std::is_signed<typename std::underlying_type<T>::type> { };
+
+	template<class T,
+		bool IsInt = (std::is_integral<T>::value && !std::is_same<T, bool>::value) || std::is_enum<T>::value,
+		bool IsPtr = std::is_pointer<T>::value && !std::is_function<typename std::remove_pointer<T>::type>::value>
+	struct abi_value { typedef T type; };
+
+	template<class T>
+	struct abi_value<T, true, false> { typedef typename abi_int<sizeof(T), abi_signed<T>::value>::type type; };
+
+	template<class T>
+	struct abi_value<T, false, true> { typedef void* type; };
+
+	template<class T>
+	struct abi_class { typedef typename abi_value<typename std::remove_cv<T>::type>::type type; };
+
+	template<class T>
+	struct abi_class<T&> { typedef typename std::conditional<std::is_function<T>::value, T&, char&>::type type; };
+
+	template<class T>
+	struct abi_class<T&&> { typedef typename std::conditional<std::is_function<T>::value, T&&, char&&>::type type; };
+
+	template<>
+	struct abi_class<void> { typedef void type; };
+
+	template<class T>
+	struct abi_return : abi_class<T> { };
+
+	template<class T>
+	struct abi_return<T&> { typedef T& type; };
+
+	template<class T>
+	struct abi_return<T&&> { typedef T&& type; };
+
+	// Decorated name spelling out T, for reports
+	template<class T>
+	constexpr const char* type_name() { return FASTDLGT_FUNCSIG; }
+}
+
+// abi_signature< R (Params...) >::type is the canonical signature of the class
+template <typename Signature> struct abi_signature;
+
+template<class R, class... Params>
+struct abi_signature< R (Params...) >
+{
+	typedef typename detail::abi_return<R>::type type (typename detail::abi_class<Params>::type...);
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+// Signatures used by delegate_dynamic<> and delegate_any in the folding mode
+// (the numbers stay 0 otherwise). 'signatures' is the number of distinct
+// signatures, 'invokers' the number of thunk sets they share.
+struct invoker_fold_stats
+{
+	size_t signatures;
+	size_t invokers;
+};
+
+namespace detail
+{
+	// Every signature registers one node at startup, into a lock-free list.
+	// Nodes are constant-initialized, so registration can't see them unset.
+	struct fold_node
+	{
+		uint64_t signature;
+		uint64_t abi_class;
+		const char *signature_name;
+		const char *abi_class_name;
+		fold_node *next;
+	};
+
+	inline std::atomic<fold_node*>& fold_list()
+	{
+		static std::atomic<fold_node*> head(0);
+		return head;
+	}
+
+	inline bool register_fold(fold_node *node)
+	{
+		node->next = fold_list().load();
+		while(!fold_list().compare_exchange_weak(node->next, node))
+			;
+		return true;
+	}
+
+	template<class Signature>
+	struct fold_record
+	{
+		static fold_node node;
+		static const bool registered;
+	};
+
+	template<class Signature>
+	fold_node fold_record<Signature>::node = { type_hash<Signature>(), type_hash<typename abi_signature<Signature>::type>(),
+		type_name<Signature>(), type_name<typename abi_signature<Signature>::type>(), 0 };
+
+	template<class Signature>
+	const bool fold_record<Signature>::registered = register_fold(&fold_record<Signature>::node);
+}
+
+inline invoker_fold_stats get_invoker_fold_stats()
+{
+	invoker_fold_stats stats = { 0, 0 };
+	for(detail::fold_node *n = detail::fold_list().load(); n; n = n->next)
+	{
+		++stats.signatures;
+		bool first = true;
+		for(detail::fold_node *p = n->next; p && first; p = p->next)
+			first = p->abi_class != n->abi_class;
+		if(first)
+			++stats.invokers;
+	}
+	return stats;
+}
+
+// Calls f(signature_name, abi_class_name) for every registered signature,
+// the names are the decorated names of detail::type_name<>()
+template<class F>
+void for_each_folded_signature(F f)
+{
+	for(detail::fold_node *n = detail::fold_list().load(); n; n = n->next)
+		f(n->signature_name, n->abi_class_name);
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+#endif //_DELEGATE_ABI_H__
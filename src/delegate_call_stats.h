@@ -0,0 +1,234 @@
+#ifndef _SF_DELEGATE_CALL_STATS_H__
+#define _SF_DELEGATE_CALL_STATS_H__
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "delegate.h"
+#include "delegate_symbols.h"
+
+namespace delegates
+{
+
+//////////////////////////////////////////////////////////////////////////
+// Call statistics
+//////////////////////////////////////////////////////////////////////////
+
+// Built with FASTDELEGATE_CALL_STATS (see delegate_config.h), every call made
+// through a delegate<> is counted and timed per target, the object / function
+// pair of the closure. That includes delegate_dynamic<> and delegate_any
+// invocations, batches and multicast_delegate<> subscribers:
+//
+//		reset_call_stats();
+//		... the frame ...
+//		call_stats_snapshot s = snapshot_call_stats();
+//		fputs(format_call_stats(s).c_str(), stderr);
+//
+// snapshot_call_stats() sums the tables of all threads and subtracts the
+// numbers taken at the last reset_call_stats(), so resetting never races
+// with the threads recording. Targets come sorted by total time. Without
+// FASTDELEGATE_CALL_STATS the snapshot is always empty.
+
+struct call_target_stats
+{
+	detail::target_id target;
+	// Code the target ran, virtual functions resolved when first recorded
+	const void *code;
+	unsigned long long calls;
+	unsigned long long total_ns;
+	// Bucket N counts calls of [2^N, 2^(N+1)) ns (see CALL_STATS_BUCKETS),
+	// batched calls are counted with their average time
+	unsigned long long histogram[CALL_STATS_BUCKETS];
+
+	// Target object, or the function itself for static functions
+	const void* object() const { return target.object; }
+	// First word of the member function pointer: the code address (for virtual
+	// functions the Itanium ABI stores the vtable offset + 1 there)
+	const void* function() const { return reinterpret_cast<const void*>(static_cast<uintptr_t>(target.function[0])); }
+	// Demangled name of the function, see delegate_symbols.h. The object
+	// isn't looked into, it may be gone by now.
+	const code_symbol& symbol() const { return resolve_target_symbol(target.object, code); }
+
+	double mean_ns() const { return calls ? double(total_ns) / double(calls) : 0.0; }
+
+	// Upper bound of the bucket reached by the given fraction of the calls, 0.99 for p99
+	unsigned long long percentile_ns(double fraction) const
+	{
+		unsigned long long seen = 0;
+		for(size_t i = 0; i != CALL_STATS_BUCKETS; ++i)
+		{
+			seen += histogram[i];
+			if(seen != 0 && double(seen) >= fraction * double(calls))
+				return 2ULL << i;
+		}
+		return 0;
+	}
+};
+
+struct call_stats_snapshot
+{
+	std::vector<call_target_stats> targets;
+	// Calls of targets which didn't fit into a thread's table (FASTDELEGATE_CALL_STATS_TARGETS)
+	unsigned long long dropped;
+
+	call_stats_snapshot() : dropped(0) { }
+};
+
+namespace detail
+{
+	inline bool call_stats_target_less(const call_target_stats &x, const call_target_stats &y) { return x.target < y.target; }
+
+	inline void accumulate_call_stats(call_target_stats &to, const call_target_stats &x)
+	{
+		to.calls += x.calls;
+		to.total_ns += x.total_ns;
+		for(size_t i = 0; i != CALL_STATS_BUCKETS; ++i)
+			to.histogram[i] += x.histogram[i];
+	}
+
+	// Sum over all thread tables, sorted by target
+	inline call_stats_snapshot collect_call_stats()
+	{
+		call_stats_snapshot s;
+#if defined(FASTDELEGATE_CALL_STATS)
+		for(const thread_record *r = call_stats_table::list().load(std::memory_order_acquire); r; r = r->next())
+		{
+			const call_stats_table *t = static_cast<const call_stats_table*>(r);
+			s.dropped += t->dropped();
+			t->for_each_entry([&s](const call_stats_entry &e) {
+				call_target_stats x;
+				x.target = e.target;
+				x.code = e.code;
+				x.calls = e.calls.load(std::memory_order_relaxed);
+				x.total_ns = e.total_ns.load(std::memory_order_relaxed);
+				for(size_t i = 0; i != CALL_STATS_BUCKETS; ++i)
+					x.histogram[i] = e.buckets[i].load(std::memory_order_relaxed);
+				s.targets.push_back(x);
+			});
+		}
+
+		std::sort(s.targets.begin(), s.targets.end(), call_stats_target_less);
+		size_t n = 0;
+		for(size_t i = 0; i != s.targets.size(); ++i)
+		{
+			if(n != 0 && s.targets[n - 1].target == s.targets[i].target)
+				accumulate_call_stats(s.targets[n - 1], s.targets[i]);
+			else
+				s.targets[n++] = s.targets[i];
+		}
+		s.targets.resize(n);
+#endif
+		return s;
+	}
+
+	struct call_stats_baseline
+	{
+		std::mutex lock;
+		call_stats_snapshot snapshot;
+	};
+
+	inline call_stats_baseline& get_call_stats_baseline()
+	{
+		static call_stats_baseline baseline;
+		return baseline;
+	}
+}
+
+// Calls since the last reset_call_stats(), summed over all threads
+inline call_stats_snapshot snapshot_call_stats()
+{
+	call_stats_snapshot s = detail::collect_call_stats();
+	{
+		detail::call_stats_baseline &base = detail::get_call_stats_baseline();
+		std::lock_guard<std::mutex> lock(base.lock);
+		const std::vector<call_target_stats> &old = base.snapshot.targets;
+		size_t n = 0;
+		for(size_t i = 0; i != s.targets.size(); ++i)
+		{
+			call_target_stats &x = s.targets[i];
+			std::vector<call_target_stats>::const_iterator it = std::lower_bound(old.begin(), old.end(), x, detail::call_stats_target_less);
+			if(it != old.end() && it->target == x.target)
+			{
+				x.calls -= it->calls;
+				x.total_ns -= it->total_ns;
+				for(size_t b = 0; b != CALL_STATS_BUCKETS; ++b)
+					x.histogram[b] -= it->histogram[b];
+			}
+			if(x.calls != 0)
+				s.targets[n++] = x;
+		}
+		s.targets.resize(n);
+		s.dropped -= base.snapshot.dropped;
+	}
+	std::sort(s.targets.begin(), s.targets.end(), [](const call_target_stats &x, const call_target_stats &y) { return x.total_ns > y.total_ns; });
+	return s;
+}
+
+// Later snapshots only count calls made from now on
+inline void reset_call_stats()
+{
+	call_stats_snapshot s = detail::collect_call_stats();
+	detail::call_stats_baseline &base = detail::get_call_stats_baseline();
+	std::lock_guard<std::mutex> lock(base.lock);
+	base.snapshot.targets.swap(s.targets);
+	base.snapshot.dropped = s.dropped;
+}
+
+// One line per target: calls, total time, mean, p50 / p99, the object and the function name
+inline std::string format_call_stats(const call_stats_snapshot &s)
+{
+	std::string out;
+	char line[256];
+	snprintf(line, sizeof(line), "%12s %12s %10s %10s %10s  %-18s %s\n", "calls", "total_us", "mean_ns", "p50_ns", "p99_ns", "object", "function");
+	out += line;
+	for(size_t i = 0; i != s.targets.size(); ++i)
+	{
+		const call_target_stats &t = s.targets[i];
+		snprintf(line, sizeof(line), "%12llu %12.1f %10.1f %10llu %10llu  %-18p ", t.calls, double(t.total_ns) / 1000.0, t.mean_ns(),
+			t.percentile_ns(0.5), t.percentile_ns(0.99), t.object());
+		out += line;
+		out += t.symbol().name;
+		out += '\n';
+	}
+	if(s.dropped)
+	{
+		snprintf(line, sizeof(line), "%12llu calls of targets which didn't fit the tables\n", s.dropped);
+		out += line;
+	}
+	return out;
+}
+
+// {"dropped": N, "targets": [{"object": "0x..", "function": "0x..", "symbol": "..", "calls": N, "total_ns": N, "histogram": [...]}, ...]}
+inline std::string format_call_stats_json(const call_stats_snapshot &s)
+{
+	std::string out;
+	char buf[256];
+	snprintf(buf, sizeof(buf), "{\"dropped\": %llu, \"targets\": [", s.dropped);
+	out += buf;
+	for(size_t i = 0; i != s.targets.size(); ++i)
+	{
+		const call_target_stats &t = s.targets[i];
+		snprintf(buf, sizeof(buf), "%s\n  {\"object\": \"%p\", \"function\": \"%p\", \"symbol\": \"", i ? "," : "", t.object(), t.function());
+		out += buf;
+		out += detail::json_escape(t.symbol().name);
+		snprintf(buf, sizeof(buf), "\", \"calls\": %llu, \"total_ns\": %llu, \"histogram\": [", t.calls, t.total_ns);
+		out += buf;
+		for(size_t b = 0; b != CALL_STATS_BUCKETS; ++b)
+		{
+			snprintf(buf, sizeof(buf), "%s%llu", b ? ", " : "", t.histogram[b]);
+			out += buf;
+		}
+		out += "]}";
+	}
+	out += s.targets.empty() ? "]}\n" : "\n]}\n";
+	return out;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+}
+
+#endif //_SF_DELEGATE_CALL_STATS_H__
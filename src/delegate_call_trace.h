@@ -0,0 +1,163 @@
+#ifndef _SF_DELEGATE_CALL_TRACE_H__
+#define _SF_DELEGATE_CALL_TRACE_H__
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "delegate.h"
+#include "delegate_symbols.h"
+
+namespace delegates
+{
+
+//////////////////////////////////////////////////////////////////////////
+// Call tracing
+//////////////////////////////////////////////////////////////////////////
+
+// Built with FASTDELEGATE_CALL_TRACE (see delegate_config.h), every call made
+// through a delegate<> (like FASTDELEGATE_CALL_STATS: dynamic invocations,
+// batches, multicast subscribers) writes a record into a ring buffer of the
+// calling thread. The collector turns the records into a timeline which
+// chrome://tracing or Perfetto can show, nested calls appear stacked and
+// labelled with the function names (delegate_symbols.h):
+//
+//		clear_call_trace();
+//		... the event cascade ...
+//		write_chrome_trace("cascade.json", collect_call_trace());
+//
+// Each ring keeps the last FASTDELEGATE_CALL_TRACE_RECORDS calls of its
+// thread. Recording can be paused with enable_call_trace(false), it still
+// reads the clock then. Without FASTDELEGATE_CALL_TRACE nothing is recorded.
+
+struct call_trace_event
+{
+	unsigned thread;			// numbered in order of the first traced call
+	const void *object;			// target object, or the function for static functions
+	const void *function;		// code address, see call_target_stats::function()
+	double start_us;			// relative to the earliest collected event
+	double duration_us;
+
+	// Demangled name of the function, see delegate_symbols.h
+	const code_symbol& symbol() const { return resolve_target_symbol(object, function); }
+};
+
+namespace detail
+{
+	// Positions in the rings at the last clear_call_trace()
+	struct call_trace_marks
+	{
+		std::mutex lock;
+		std::vector< std::pair<const void*, unsigned long long> > positions;
+
+		unsigned long long position(const void *ring) const
+		{
+			for(size_t i = 0; i != positions.size(); ++i)
+				if(positions[i].first == ring)
+					return positions[i].second;
+			return 0;
+		}
+	};
+
+	inline call_trace_marks& get_call_trace_marks()
+	{
+		static call_trace_marks marks;
+		return marks;
+	}
+}
+
+inline void enable_call_trace(bool enable)
+{
+#if defined(FASTDELEGATE_CALL_TRACE)
+	detail::call_trace_enabled().store(enable, std::memory_order_relaxed);
+#else
+	(void)enable;
+#endif
+}
+
+// Events recorded since the last clear_call_trace() which are still in the
+// rings, sorted by start time
+inline std::vector<call_trace_event> collect_call_trace()
+{
+	std::vector<call_trace_event> events;
+#if defined(FASTDELEGATE_CALL_TRACE)
+	detail::call_trace_marks &marks = detail::get_call_trace_marks();
+	std::lock_guard<std::mutex> lock(marks.lock);
+	const double scale = detail::call_clock_scale() / 1000.0;
+	unsigned long long origin = ~0ULL;
+	std::vector<unsigned long long> starts;
+
+	for(const detail::thread_record *r = detail::call_trace_ring::list().load(std::memory_order_acquire); r; r = r->next())
+	{
+		const detail::call_trace_ring &ring = static_cast<const detail::call_trace_ring&>(*r);
+		ring.read(marks.position(&ring), [&](unsigned thread, unsigned long long start, unsigned long long duration,
+			unsigned long long object, unsigned long long function)
+		{
+			call_trace_event e;
+			e.thread = thread;
+			e.object = reinterpret_cast<const void*>(static_cast<uintptr_t>(object));
+			e.function = reinterpret_cast<const void*>(static_cast<uintptr_t>(function));
+			e.start_us = 0;
+			e.duration_us = double(duration) * scale;
+			events.push_back(e);
+			starts.push_back(start);
+			origin = std::min(origin, start);
+		});
+	}
+
+	for(size_t i = 0; i != events.size(); ++i)
+		events[i].start_us = double(starts[i] - origin) * scale;
+	std::sort(events.begin(), events.end(), [](const call_trace_event &x, const call_trace_event &y) { return x.start_us < y.start_us; });
+#endif
+	return events;
+}
+
+// Later collections only return calls recorded from now on
+inline void clear_call_trace()
+{
+#if defined(FASTDELEGATE_CALL_TRACE)
+	detail::call_trace_marks &marks = detail::get_call_trace_marks();
+	std::lock_guard<std::mutex> lock(marks.lock);
+	marks.positions.clear();
+	for(const detail::thread_record *r = detail::call_trace_ring::list().load(std::memory_order_acquire); r; r = r->next())
+		marks.positions.push_back(std::make_pair(static_cast<const void*>(r), static_cast<const detail::call_trace_ring*>(r)->position()));
+#endif
+}
+
+// Chrome trace event format: one complete ("X") event per call, named after
+// the function, with the object and function addresses in "args"
+inline std::string format_chrome_trace(const std::vector<call_trace_event> &events)
+{
+	std::string out = "{\"traceEvents\": [";
+	char buf[256];
+	for(size_t i = 0; i != events.size(); ++i)
+	{
+		const call_trace_event &e = events[i];
+		out += i ? ",\n  {\"name\": \"" : "\n  {\"name\": \"";
+		out += detail::json_escape(e.symbol().name);
+		snprintf(buf, sizeof(buf), "\", \"cat\": \"delegate\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": 1, \"tid\": %u, \"args\": {\"object\": \"%p\", \"function\": \"%p\"}}",
+			e.start_us, e.duration_us, e.thread, e.object, e.function);
+		out += buf;
+	}
+	out += "\n], \"displayTimeUnit\": \"ns\"}\n";
+	return out;
+}
+
+inline bool write_chrome_trace(const char *path, const std::vector<call_trace_event> &events)
+{
+	FILE *f = fopen(path, "w");
+	if(!f)
+		return false;
+	std::string json = format_chrome_trace(events);
+	bool ok = fwrite(json.data(), 1, json.size(), f) == json.size();
+	return fclose(f) == 0 && ok;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+}
+
+#endif //_SF_DELEGATE_CALL_TRACE_H__
@@ -48,6 +48,85 @@
 
 namespace detail {
 
+	// Hashing of closure data, see function_data::GetHash().
+	// Words are folded in with a multiply each, the result is mixed once at the end.
+	inline unsigned long long hash_mix(unsigned long long x)
+	{
+		x ^= x >> 33; x *= 0xff51afd7ed558ccdULL;
+		x ^= x >> 33; x *= 0xc4ceb9fe1a85ec53ULL;
+		x ^= x >> 33;
+		return x;
+	}
+
+	template<class T>
+	inline unsigned long long hash_bytes(unsigned long long h, const T &v)
+	{
+		unsigned long long words[(sizeof(T) + sizeof(unsigned long long) - 1) / sizeof(unsigned long long)] = { };
+		memcpy(words, &v, sizeof(T));
+		for(size_t i = 0; i != sizeof(words) / sizeof(words[0]); ++i)
+		{
+			h = (h ^ words[i]) * 0x9e3779b97f4a7c15ULL;
+			h ^= h >> 29;
+		}
+		return h;
+	}
+
+#if defined(FASTDELEGATE_EMPTY_SINK)
+	// 'this' of the no-op which empty delegates call (FASTDELEGATE_EMPTY_SINK),
+	// marks a closure as empty. The no-op itself depends on the signature,
+	// see detail::empty_sink.
+	inline GenericClass* empty_sink_object()
+	{
+		static char object;
+		return reinterpret_cast<GenericClass*>(&object);
+	}
+#endif
+
+	// What a closure calls: the object (or the function, for static functions)
+	// and the raw bytes of the member function pointer. Used to attribute
+	// statistics to targets, see function_data::GetTargetId().
+	struct target_id
+	{
+		const void *object;
+		unsigned long long function[(sizeof(void (GenericClass::*)()) + sizeof(unsigned long long) - 1) / sizeof(unsigned long long)];
+
+		bool operator == (const target_id &x) const { return memcmp(this, &x, sizeof(target_id)) == 0; }
+		bool operator < (const target_id &x) const { return memcmp(this, &x, sizeof(target_id)) < 0; }
+	};
+
+FASTDLGT_BEGIN_MFP_TRICKS
+	// Code address of a target. The member function pointer of a virtual
+	// function holds its vtable slot, the function is read from the object.
+	// Kept out of line, inlined the compiler checks the read against the
+	// static type of the object.
+	FASTDLGT_NOINLINE inline const void* target_code_address(const target_id &target)
+	{
+#if defined(FASTDLGT_ITANIUM_ABI) && (defined(__x86_64__) || defined(__i386__) || defined(__aarch64__) || defined(__arm__))
+		struct { intptr_t ptr, adj; } m;
+		static_assert(sizeof(m) <= sizeof(target.function), "Unexpected member function pointer layout");
+		memcpy(&m, target.function, sizeof(m));
+#	if defined(__aarch64__) || defined(__arm__)
+		const bool is_virtual = (m.adj & 1) != 0;
+		const intptr_t adj = m.adj >> 1, slot = m.ptr;
+#	else
+		const bool is_virtual = (m.ptr & 1) != 0;
+		const intptr_t adj = m.adj, slot = m.ptr - 1;
+#	endif
+		if(is_virtual && target.object)
+		{
+			const char *vtable;
+			const void *code;
+			memcpy(&vtable, static_cast<const char*>(target.object) + adj, sizeof(vtable));
+			memcpy(&code, vtable + slot, sizeof(code));
+			return code;
+		}
+		return reinterpret_cast<const void*>(m.ptr);
+#else
+		return reinterpret_cast<const void*>(static_cast<uintptr_t>(target.function[0]));
+#endif
+	}
+FASTDLGT_END_MFP_TRICKS
+
 	class function_data 
 	{
 	protected: 
@@ -84,8 +163,9 @@ namespace detail {
 			if (m_pFunction!=x.m_pFunction) return false;
 			// the static function ptrs must either both be equal, or both be 0.
 			if (m_pStaticFunction!=x.m_pStaticFunction) return false;
-			if (m_pStaticFunction!=0) return m_pthis==x.m_pthis;
-			else return true;
+			// for static functions m_pthis is a self-reference and must not be compared
+			if (m_pStaticFunction!=0) return true;
+			else return m_pthis==x.m_pthis;
 		}
 #else // Evil Method
 		inline bool IsEqual (const function_data &x) const
@@ -111,26 +191,45 @@ namespace detail {
 
 		}
 
+		// Hash consistent with IsEqual, for hashed containers. Like IsLess it
+		// treats the member function pointer as raw bytes.
+		inline size_t GetHash() const
+		{
+#if !defined(FASTDELEGATE_USESTATICFUNCTIONHACK)
+			if (m_pStaticFunction != 0)
+				return static_cast<size_t>(hash_mix(hash_bytes(hash_bytes(0, m_pStaticFunction), m_pFunction)));
+#endif
+			return static_cast<size_t>(hash_mix(hash_bytes(hash_bytes(0, m_pthis), m_pFunction)));
+		}
+
+		// Equal for closures which IsEqual
+		inline target_id GetTargetId() const
+		{
+			target_id id = { };
+			id.object = m_pthis;
+#if !defined(FASTDELEGATE_USESTATICFUNCTIONHACK)
+			if (m_pStaticFunction != 0)
+				id.object = reinterpret_cast<const void*>(m_pStaticFunction);
+#endif
+			memcpy(id.function, &m_pFunction, sizeof(m_pFunction));
+			return id;
+		}
+
+#if defined(FASTDELEGATE_EMPTY_SINK)
+		// Bound to the no-op, or never bound (raw function_data)
+		inline bool operator ! () const { return empty(); }
+		inline bool empty() const { return m_pthis==empty_sink_object() || (m_pthis==0 && m_pFunction==0); }
+#else
 		inline bool operator ! () const { return m_pthis==0 && m_pFunction==0; }
 		inline bool empty() const { return m_pthis==0 && m_pFunction==0; }
+#endif
 
 	public:
-		function_data & operator=(const function_data &right)  
-		{
-			SetMementoFrom(right); 
-			return *this;
-		}
+		// Copy constructor and assignment are implicit, function_data is trivially
+		// copyable. Closures must still be copied with CopyFrom() (self-references).
 		inline bool operator <(const function_data &right) { return IsLess(right); }
 		inline bool operator >(const function_data &right) { return right.IsLess(*this); }
 
-		function_data (const function_data &right)  
-			: m_pFunction(right.m_pFunction)
-			, m_pthis(right.m_pthis)
-#if !defined(FASTDELEGATE_USESTATICFUNCTIONHACK)
-			, m_pStaticFunction (right.m_pStaticFunction)
-#endif
-		{ }
-
 
 		// Hacky methods for reflection library
 		GenericClass* getThisPtr() const { return m_pthis; }
@@ -203,7 +302,9 @@ namespace detail {
 
 		// These functions are required for invoking the stored function
 		inline GenericClass *GetClosureThis() const { return m_pthis; }
+FASTDLGT_BEGIN_MFP_TRICKS
 		inline GenericMemFunc GetClosureMemPtr() const { return reinterpret_cast<GenericMemFunc>(m_pFunction); }
+FASTDLGT_END_MFP_TRICKS
 
 		// There are a few ways of dealing with static function pointers.
 		// There's a standard-compliant, but tricky method.
@@ -264,7 +365,7 @@ namespace detail {
 		// support static_cast between void * and function pointers.
 
 		template< class DerivedClass >
-		inline void CopyFrom (DerivedClass *pParent, const function_data &right) 
+		inline void CopyFrom (DerivedClass * /*pParent*/, const function_data &right) 
 		{
 			SetMementoFrom(right);
 		}
@@ -0,0 +1,272 @@
+#ifndef _SF_DELEGATE_CONCURRENT_H__
+#define _SF_DELEGATE_CONCURRENT_H__
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "delegate_multicast.h"
+
+namespace delegates
+{
+
+//////////////////////////////////////////////////////////////////////////
+// Concurrent multicast delegates
+//////////////////////////////////////////////////////////////////////////
+
+// concurrent_multicast_delegate<> can be fired from any number of threads
+// while other threads subscribe and unsubscribe.
+//
+// Subscribers are kept in an immutable snapshot (a plain multicast_delegate).
+// Firing never takes a lock: it registers itself in a striped reader counter,
+// loads the current snapshot and runs it. That's two uncontended atomic
+// increments per fire, so firing is wait-free.
+//
+// The reader counter is split into stripes padded to cache lines, by default
+// as many as there are hardware threads (rounded up to a power of 2), so that
+// threads firing at the same time don't share counters. The ReaderStripes
+// template argument fixes the number instead.
+//
+// Writers are serialized by a mutex. Each modification copies the snapshot,
+// publishes the copy and waits for a grace period (all readers which could
+// still see the old snapshot have left) before deleting the old one.
+// Modifications made from inside a handler don't wait, the old snapshots
+// are deleted by the next writer or by the destructor instead.
+//
+// Destruction must not overlap with firing.
+
+namespace detail
+{
+	// Number of concurrent fires currently running on the calling thread
+	inline int& concurrent_fire_depth()
+	{
+		static thread_local int depth = 0;
+		return depth;
+	}
+
+	// Every thread gets its own reader counter stripe
+	inline size_t concurrent_reader_stripe()
+	{
+		static std::atomic<size_t> next_stripe(0);
+		static thread_local size_t stripe = next_stripe.fetch_add(1, std::memory_order_relaxed);
+		return stripe;
+	}
+
+	struct padded_counter
+	{
+		std::atomic<long> value;
+		char padding[CACHE_LINE_SIZE - sizeof(std::atomic<long>)];
+	};
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+template <typename Signature, size_t ReaderStripes = 0>
+class concurrent_multicast_delegate
+{
+public:
+	typedef multicast_delegate<Signature> snapshot_type;
+	typedef typename snapshot_type::delegate_type delegate_type;
+	typedef concurrent_multicast_delegate this_type;
+
+	concurrent_multicast_delegate() : m_Snapshot(0), m_Epoch(0), m_Stripes(stripes_for(ReaderStripes))
+	{
+		// Two epochs of counters, aligned to cache lines
+		m_ReaderStorage = new char[2 * m_Stripes * sizeof(detail::padded_counter) + CACHE_LINE_SIZE];
+		m_Readers = reinterpret_cast<detail::padded_counter*>(m_ReaderStorage + CACHE_LINE_SIZE
+			- reinterpret_cast<uintptr_t>(m_ReaderStorage) % CACHE_LINE_SIZE);
+		for(size_t i = 0; i != 2 * m_Stripes; ++i)
+			new (&m_Readers[i]) detail::padded_counter();
+		for(size_t i = 0; i != 2 * m_Stripes; ++i)
+			m_Readers[i].value.store(0, std::memory_order_relaxed);
+	}
+
+	~concurrent_multicast_delegate()
+	{
+		delete m_Snapshot.load(std::memory_order_relaxed);
+		free_retired();
+		delete[] m_ReaderStorage;
+	}
+
+	// Number of reader counter stripes per epoch
+	size_t reader_stripes() const { return m_Stripes; }
+
+	// Subscription, can be called concurrently with firing
+	void add(const delegate_type &d)
+	{
+		if(d.empty())
+			return;
+
+		std::lock_guard<std::mutex> lock(m_WriteLock);
+		const snapshot_type *cur = m_Snapshot.load(std::memory_order_relaxed);
+		snapshot_type *next = cur ? new snapshot_type(*cur) : new snapshot_type();
+		next->add(d);
+		publish(next);
+	}
+
+	// Removes first subscription equal to the delegate, returns false if there is none
+	bool remove(const delegate_type &d)
+	{
+		std::lock_guard<std::mutex> lock(m_WriteLock);
+		const snapshot_type *cur = m_Snapshot.load(std::memory_order_relaxed);
+		if(!cur || !cur->contains(d))
+			return false;
+
+		snapshot_type *next = 0;
+		if(cur->size() != 1)
+		{
+			next = new snapshot_type(*cur);
+			next->remove(d);
+		}
+		publish(next);
+		return true;
+	}
+
+	void operator += (const delegate_type &d) { add(d); }
+	void operator -= (const delegate_type &d) { remove(d); }
+
+	void clear()
+	{
+		std::lock_guard<std::mutex> lock(m_WriteLock);
+		publish(0);
+	}
+
+	bool contains(const delegate_type &d) const
+	{
+		read_section rs(*this);
+		const snapshot_type *s = m_Snapshot.load();
+		return s && s->contains(d);
+	}
+
+	size_t size() const
+	{
+		read_section rs(*this);
+		const snapshot_type *s = m_Snapshot.load();
+		return s ? s->size() : 0;
+	}
+
+	bool empty() const { return m_Snapshot.load() == 0; }
+
+	// Invoke all subscribers of the current snapshot.
+	// Subscribers added or removed during the call may or may not be called.
+
+	template<class... Pf>
+	void operator() (Pf&&... params) const
+	{
+		read_section rs(*this);
+		if(const snapshot_type *s = m_Snapshot.load()) (*s)(params...);
+	}
+
+private:
+	concurrent_multicast_delegate(const concurrent_multicast_delegate &);
+	void operator = (const concurrent_multicast_delegate &);
+
+	// Registers the reader in the counter of the current epoch for its lifetime.
+	// All operations are sequentially consistent, so the snapshot loaded
+	// after entering is never older than one a writer could have freed.
+	class read_section
+	{
+	public:
+		read_section(const this_type &owner)
+			: m_Counter(owner.reader_counter(owner.m_Epoch.load() & 1, detail::concurrent_reader_stripe()))
+		{
+			m_Counter.fetch_add(1);
+			++detail::concurrent_fire_depth();
+		}
+
+		~read_section()
+		{
+			--detail::concurrent_fire_depth();
+			m_Counter.fetch_sub(1, std::memory_order_release);
+		}
+
+	private:
+		read_section(const read_section &);
+		void operator = (const read_section &);
+		std::atomic<long> &m_Counter;
+	};
+
+	// Power of 2 at least as large as the requested count or, for 0, the
+	// number of hardware threads
+	static size_t stripes_for(size_t requested)
+	{
+		size_t n = requested ? requested : std::thread::hardware_concurrency();
+		size_t stripes = 1;
+		while(stripes < n)
+			stripes <<= 1;
+		return n ? stripes : 16;
+	}
+
+	std::atomic<long>& reader_counter(size_t epoch, size_t stripe) const
+	{
+		return m_Readers[epoch * m_Stripes + (stripe & (m_Stripes - 1))].value;
+	}
+
+	// Called by writers with m_WriteLock held
+	void publish(snapshot_type *next)
+	{
+		const snapshot_type *old = m_Snapshot.exchange(next);
+		if(old)
+			m_Retired.push_back(old);
+
+		// Waiting from inside a handler could wait for ourselves
+		if(detail::concurrent_fire_depth() != 0)
+			return;
+
+		synchronize();
+		free_retired();
+	}
+
+	// Waits until every reader that entered before the call has left.
+	// Epoch is flipped twice so that readers which picked a counter
+	// right before a flip are waited for too.
+	void synchronize()
+	{
+		for(int round = 0; round != 2; ++round)
+		{
+			size_t idx = m_Epoch.load(std::memory_order_relaxed) & 1;
+			m_Epoch.store(m_Epoch.load(std::memory_order_relaxed) + 1);
+
+			for(;;)
+			{
+				long readers = 0;
+				for(size_t s = 0; s != m_Stripes; ++s)
+					readers += reader_counter(idx, s).load();
+				if(readers == 0)
+					break;
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	void free_retired()
+	{
+		for(size_t i = 0; i != m_Retired.size(); ++i)
+			delete m_Retired[i];
+		m_Retired.clear();
+	}
+
+	std::atomic<const snapshot_type*> m_Snapshot;
+	std::atomic<size_t> m_Epoch;
+	const size_t m_Stripes;
+	char *m_ReaderStorage;
+	detail::padded_counter *m_Readers;
+
+	std::mutex m_WriteLock;
+	std::vector<const snapshot_type*> m_Retired;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+// Same as concurrent_multicast_delegate, reads better for event members
+template <typename Signature>
+class concurrent_event : public concurrent_multicast_delegate<Signature>
+{
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+}
+
+#endif //_SF_DELEGATE_CONCURRENT_H__
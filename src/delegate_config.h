@@ -8,8 +8,8 @@
 //
 ////////////////////////////////////////////////////////////////////////////////
 
-// Defines the maximum invoke arguments of delegate
-static const int MAX_INVOKE_ARGS = 5;
+// Assumed size of the CPU cache line, used to pad data shared between threads
+static const int CACHE_LINE_SIZE = 64;
 
 // Uncomment the following #define for optimally-sized DELEGATEs.
 // In this case, the generated asm code is almost identical to the code you'd get
@@ -19,9 +19,33 @@ static const int MAX_INVOKE_ARGS = 5;
 // It will also probably fail on some DSP systems.
 #define FASTDELEGATE_USESTATICFUNCTIONHACK
 
-// Uncomment the next line to allow function declarator syntax.
-// It is automatically enabled for those compilers where it is known to work.
-//#define FASTDELEGATE_ALLOW_FUNCTION_TYPE_SYNTAX
+// Uncomment the following #define to let delegate_dynamic<> and delegate_any
+// share their unpacking code between signatures which the calling convention
+// passes identically (pointers of any type, references, same-sized integers),
+// see delegate_abi.h. Saves code size with many reflected signatures.
+//#define FASTDELEGATE_FOLD_ABI_SIGNATURES
+
+// Uncomment the following #define to count the calls of every delegate target
+// and record their latency histograms, see delegate_call_stats.h. Each call
+// then reads the clock twice and updates a per-thread table, off it costs nothing.
+//#define FASTDELEGATE_CALL_STATS
+
+// Uncomment the following #define to record every delegate call (start, duration,
+// thread, target) into per-thread ring buffers, which delegate_call_trace.h
+// exports as a Chrome trace. Costs two clock reads and a 32-byte write per call.
+//#define FASTDELEGATE_CALL_TRACE
+
+// Uncomment the following #define to bind empty delegates to a no-op of their
+// signature which returns a value-initialized result. Calling an empty delegate
+// is then harmless, so optional callbacks can be called without checking them
+// first. empty() and operator ! still report such delegates as empty.
+//#define FASTDELEGATE_EMPTY_SINK
+
+// Uncomment the following #define to resolve virtual member functions when a
+// delegate is bound (GCC, Clang: Itanium C++ ABI on x86 and ARM). Calls then go
+// straight to the override, without the vtable lookup. Objects must be fully
+// constructed when they're bound, see ResolveItaniumMemFunc() in delegate_utils.h.
+//#define FASTDELEGATE_RESOLVE_VIRTUALS
 
 ////////////////////////////////////////////////////////////////////////////////
 //						Compiler identification for workarounds
@@ -47,19 +71,47 @@ static const int MAX_INVOKE_ARGS = 5;
 #endif
 #endif
 
-// Does it allow function declarator syntax? The following compilers are known to work:
-#if defined(FASTDLGT_ISMSVC) && (_MSC_VER >=1310) // VC 7.1
-#	define FASTDELEGATE_ALLOW_FUNCTION_TYPE_SYNTAX
+// Does the compiler follow the Itanium C++ ABI? (GCC, Clang and compatible ones
+// on non-Windows targets). It defines the layout of member function pointers
+// and how class objects are passed by value, which some optimizations rely on.
+#if defined(__GNUC__) && !defined(_WIN32)
+#	define FASTDLGT_ITANIUM_ABI
+#endif
+
+// Decorated name of the enclosing function (includes template arguments),
+// used to derive type ids without RTTI
+#if defined(FASTDLGT_ISMSVC)
+#	define FASTDLGT_FUNCSIG __FUNCSIG__
+#else
+#	define FASTDLGT_FUNCSIG __PRETTY_FUNCTION__
+#endif
+
+// The function pointer conversions the closures are built on are intentional,
+// GCC 8+ warns about them with -Wextra (-Wcast-function-type). Calls through
+// a member function pointer of an object without a virtual table can also
+// trigger a false -Warray-bounds for the virtual function branch.
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 8
+#	define FASTDLGT_BEGIN_MFP_TRICKS _Pragma("GCC diagnostic push") _Pragma("GCC diagnostic ignored \"-Wcast-function-type\"") \
+		_Pragma("GCC diagnostic ignored \"-Warray-bounds\"")
+#	define FASTDLGT_END_MFP_TRICKS _Pragma("GCC diagnostic pop")
+#else
+#	define FASTDLGT_BEGIN_MFP_TRICKS
+#	define FASTDLGT_END_MFP_TRICKS
 #endif
 
-// Gcc(2.95+), and versions of Digital Mars, Intel and Comeau in common use.
-#if defined (__DMC__) || defined(__GNUC__) || defined(__ICL) || defined(__COMO__)
-#	define FASTDELEGATE_ALLOW_FUNCTION_TYPE_SYNTAX
+// Keeps a function out of line, for code which is meant to be shared
+#if defined(FASTDLGT_ISMSVC)
+#	define FASTDLGT_NOINLINE __declspec(noinline)
+#elif defined(__GNUC__)
+#	define FASTDLGT_NOINLINE __attribute__((noinline))
+#else
+#	define FASTDLGT_NOINLINE
 #endif
 
-// It works on Metrowerks MWCC 3.2.2. From boost.Config it should work on earlier ones too.
-#if defined (__MWERKS__)
-#	define FASTDELEGATE_ALLOW_FUNCTION_TYPE_SYNTAX
+// Are template<auto> parameters supported (C++17)? make_delegate<&Target>()
+// deduces the signature of the target from them.
+#if defined(__cpp_nontype_template_parameter_auto) || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#	define FASTDLGT_HAS_AUTO_TEMPLATE_PARAMS
 #endif
 
 #ifdef __GNUC__ // Workaround GCC bug #8271 
@@ -0,0 +1,235 @@
+#ifndef _SF_DELEGATE_CORO_H__
+#define _SF_DELEGATE_CORO_H__
+
+#include "delegate.h"
+
+#if __cplusplus >= 202002L || (defined(_MSVC_LANG) && _MSVC_LANG >= 202002L)
+
+#include <coroutine>
+#include <mutex>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "delegate_executor.h"
+
+namespace delegates
+{
+
+//////////////////////////////////////////////////////////////////////////
+// Coroutine support (C++20)
+//////////////////////////////////////////////////////////////////////////
+
+// awaitable_event<> lets coroutines wait for the next firing of an event
+// (multicast_delegate<>, event<> or their concurrent versions):
+//
+//		event< void (int, const std::string&) > changed;
+//		awaitable_event< event< void (int, const std::string&) > > on_changed(changed);
+//		...
+//		auto [id, name] = co_await on_changed.next();
+//
+// The adapter subscribes to the event once. Waiting coroutines are kept in
+// an intrusive list of awaiters, which live in the coroutine frames, so
+// suspending and resuming doesn't allocate. A firing takes over the whole
+// list, stores a copy of the arguments in every awaiter and resumes the
+// coroutines in the order they started waiting, on the firing thread.
+// Coroutines which wait again from there are resumed by the next firing.
+//
+// The result of co_await is nothing for events without parameters, the
+// parameter value for one parameter and a std::tuple of values otherwise.
+//
+// The adapter must not be destroyed while coroutines wait on it.
+
+namespace detail
+{
+	template<class... Params>
+	struct event_result { typedef std::tuple<typename std::decay<Params>::type...> type; };
+
+	template<class P>
+	struct event_result<P> { typedef typename std::decay<P>::type type; };
+
+	template<>
+	struct event_result<> { typedef void type; };
+
+	template<class Signature>
+	struct event_signature_traits;
+
+	template<class... Params>
+	struct event_signature_traits< void (Params...) >
+	{
+		typedef typename event_result<Params...>::type result_type;
+		typedef std::conditional_t<std::is_void<result_type>::value, bool, result_type> stored_type;
+
+		template<class... A>
+		static stored_type make(A&... args)
+		{
+			if constexpr(sizeof...(A) == 0)
+				return true;
+			else
+				return stored_type(args...);
+		}
+	};
+}
+
+template<class Event, class Signature = typename Event::delegate_type::type>
+class awaitable_event;
+
+template<class Event, class... Params>
+class awaitable_event<Event, delegate< void (Params...) > >
+{
+	typedef detail::event_signature_traits< void (Params...) > traits;
+	typedef delegate< void (Params...) > handler_type;
+
+public:
+	typedef typename traits::result_type result_type;
+
+	class awaiter
+	{
+	public:
+		explicit awaiter(awaitable_event &owner) : m_Owner(owner), m_Next(0) { }
+
+		bool await_ready() const { return false; }
+		void await_suspend(std::coroutine_handle<> h) { m_Handle = h; m_Owner.push(this); }
+		result_type await_resume()
+		{
+			if constexpr(!std::is_void<result_type>::value)
+				return std::move(*m_Value);
+		}
+
+	private:
+		friend class awaitable_event;
+
+		awaiter(const awaiter &);
+		void operator = (const awaiter &);
+
+		awaitable_event &m_Owner;
+		awaiter *m_Next;
+		std::coroutine_handle<> m_Handle;
+		std::optional<typename traits::stored_type> m_Value;
+	};
+
+	explicit awaitable_event(Event &ev) : m_Event(ev), m_First(0), m_Last(0)
+	{
+		m_Event.add(handler_type(this, &awaitable_event::on_fire));
+	}
+
+	~awaitable_event() { m_Event.remove(handler_type(this, &awaitable_event::on_fire)); }
+
+	// co_await next() suspends until the event fires
+	awaiter next() { return awaiter(*this); }
+
+	// Is any coroutine waiting?
+	bool waiting() const
+	{
+		std::lock_guard<std::mutex> l(m_Lock);
+		return m_First != 0;
+	}
+
+private:
+	awaitable_event(const awaitable_event &);
+	void operator = (const awaitable_event &);
+
+	void push(awaiter *a)
+	{
+		std::lock_guard<std::mutex> l(m_Lock);
+		if(m_Last)
+			m_Last->m_Next = a;
+		else
+			m_First = a;
+		m_Last = a;
+	}
+
+	void on_fire(Params... params)
+	{
+		awaiter *a;
+		{
+			std::lock_guard<std::mutex> l(m_Lock);
+			a = m_First;
+			m_First = m_Last = 0;
+		}
+
+		while(a)
+		{
+			// the awaiter is gone once its coroutine runs
+			awaiter *next = a->m_Next;
+			a->m_Value.emplace(traits::make(params...));
+			a->m_Handle.resume();
+			a = next;
+		}
+	}
+
+	Event &m_Event;
+	mutable std::mutex m_Lock;
+	awaiter *m_First;
+	awaiter *m_Last;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+// co_await async_call(pool, d, args...) runs d(args...) on a delegate_executor
+// and resumes the coroutine on the worker thread when it has finished. The
+// task lives in the awaiter (in the coroutine frame), nothing is allocated.
+// The result is returned, an exception thrown by the delegate is rethrown.
+
+namespace detail
+{
+	template<class R, class Signature, class... Args>
+	class resuming_call : public task_call<R, Signature, typename make_index_list<sizeof...(Args)>::type, Args...>
+	{
+		typedef task_call<R, Signature, typename make_index_list<sizeof...(Args)>::type, Args...> base;
+
+	public:
+		template<class D, class... A>
+		resuming_call(const D &d, A&&... args) : base(d, std::forward<A>(args)...) { }
+
+		std::coroutine_handle<> handle;
+
+	protected:
+		// The executor is done with the node, the coroutine may destroy it now
+		virtual void destroy() { handle.resume(); }
+	};
+}
+
+template<class R, class Signature, class... Args>
+class async_call_awaiter
+{
+public:
+	template<class... A>
+	async_call_awaiter(delegate_executor &pool, const delegate<Signature> &d, A&&... args)
+		: m_Pool(pool), m_Call(d, std::forward<A>(args)...)
+	{ }
+
+	bool await_ready() const { return false; }
+
+	void await_suspend(std::coroutine_handle<> h)
+	{
+		m_Call.handle = h;
+		m_Call.release(); // no future, the queue keeps the only reference
+		m_Pool.submit_task(&m_Call);
+	}
+
+	R await_resume() { return m_Call.get(); }
+
+private:
+	async_call_awaiter(const async_call_awaiter &);
+	void operator = (const async_call_awaiter &);
+
+	delegate_executor &m_Pool;
+	detail::resuming_call<R, Signature, Args...> m_Call;
+};
+
+template<class R, class... Params, class... Args>
+async_call_awaiter<R, R (Params...), typename std::decay<Args>::type...>
+	async_call(delegate_executor &pool, const delegate< R (Params...) > &d, Args&&... args)
+{
+	static_assert(sizeof...(Args) == sizeof...(Params), "Wrong number of arguments for the delegate");
+	return async_call_awaiter<R, R (Params...), typename std::decay<Args>::type...>(pool, d, std::forward<Args>(args)...);
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+}
+
+#endif // C++20
+
+#endif //_SF_DELEGATE_CORO_H__
@@ -2,12 +2,24 @@
 #define _DELEGATE_DELEG_DYNN_H__
 
 #include "delegate_delegn.h"
+#include "delegate_signature.h"
+#include "delegate_abi.h"
 #include "typetraits.h"
 
 //////////////////////////////////////////////////////////////////////////
 // Dynamic delegates
 //////////////////////////////////////////////////////////////////////////
 
+// Flags of delegate_dynamic_base::invoke_ex()
+enum invoke_mode
+{
+	invoke_default			= 0,
+	// By-value arguments are moved out of args[N], the caller may only destroy them afterwards
+	invoke_move_args		= 1,
+	// 'ret' is uninitialized storage, the result is constructed there
+	invoke_construct_ret	= 2
+};
+
 // Declares pure virtual function for dynamic invocation of function
 class delegate_dynamic_base
 {
@@ -16,286 +28,378 @@ public:
 	virtual const detail::function_data& getFunctionData() = 0;
 	virtual void setFunctionData(const detail::function_data &any) = 0;
 	virtual void invoke(void ** args, void * ret) const = 0;
-};
+	// invoke() with a combination of invoke_mode flags
+	virtual void invoke_ex(void ** args, void * ret, unsigned mode) const = 0;
 
-//////////////////////////////////////////////////////////////////////////
+	void invoke_move(void ** args, void * ret) const { invoke_ex(args, ret, invoke_move_args); }
+	void invoke_construct(void ** args, void * ret) const { invoke_ex(args, ret, invoke_construct_ret); }
 
-#define UP_ARG(T, N)		(*(t_strip<T>::noref*)args[N])
-#define UP_RET()			(*(t_strip<R>::norefp*)rt)
+	// Batched invocation, 'count' calls for one virtual dispatch.
+	// Row-oriented: arg_rows[i] is the argument array of the i-th call,
+	// results are written to ret_base + i * ret_stride (ret_base may be 0).
+	virtual void invoke_batch(void *** arg_rows, void * ret_base, size_t ret_stride, size_t count) const = 0;
+	// Column-oriented: argument N of the i-th call is at arg_bases[N] + i * arg_strides[N]
+	virtual void invoke_batch_columns(void ** arg_bases, const size_t * arg_strides, void * ret_base, size_t ret_stride, size_t count) const = 0;
 
-template<class Deleg, class R>
-struct rt_invoker0 {
-	inline static void invoke(void ** args, void * rt, const Deleg& dlg) { if(rt) UP_RET() = dlg(); else dlg(); }
-};
-template<class Deleg>
-struct rt_invoker0<Deleg, void> {
-	inline static void invoke(void ** args, void * rt, const Deleg& dlg) { dlg(); }
-};
+	// Arguments are taken from a single buffer laid out by frame_layout<>
+	virtual void invoke_frame(void * frame, void * ret) const = 0;
 
-template<class Deleg, class P1, class R>
-struct rt_invoker1 {
-	inline static void invoke(void ** args, void * rt, const Deleg& dlg) { if(rt) UP_RET() = dlg(UP_ARG(P1, 0)); else dlg(UP_ARG(P1, 0)); }
-};
-template<class Deleg, class P1>
-struct rt_invoker1<Deleg, P1, void> {
-	inline static void invoke(void ** args, void * rt, const Deleg& dlg) { dlg(UP_ARG(P1, 0)); }
-};
+	// Parameter and return value layout, shared by all delegates of the signature
+	const signature_desc& signature() const { return *m_Signature; }
 
-template<class Deleg, class P1, class P2, class R>
-struct rt_invoker2 {
-	inline static void invoke(void ** args, void * rt, const Deleg& dlg) { if(rt) UP_RET() = dlg(UP_ARG(P1, 0), UP_ARG(P2, 1)); else dlg(UP_ARG(P1, 0), UP_ARG(P2, 1)); }
-};
-template<class Deleg, class P1, class P2>
-struct rt_invoker2<Deleg, P1, P2, void> {
-	inline static void invoke(void ** args, void * rt, const Deleg& dlg) { dlg(UP_ARG(P1, 0), UP_ARG(P2, 1)); }
-};
-
-template<class Deleg, class P1, class P2, class P3, class R>
-struct rt_invoker3 {
-	inline static void invoke(void ** args, void * rt, const Deleg& dlg) { if(rt) UP_RET() = dlg(UP_ARG(P1, 0), UP_ARG(P2, 1), UP_ARG(P3, 2)); else dlg(UP_ARG(P1, 0), UP_ARG(P2, 1), UP_ARG(P3, 2)); }
-};
-template<class Deleg, class P1, class P2, class P3>
-struct rt_invoker3<Deleg, P1, P2, P3, void> {
-	inline static void invoke(void ** args, void * rt, const Deleg& dlg) { dlg(UP_ARG(P1, 0), UP_ARG(P2, 1), UP_ARG(P3, 2)); }
-};
-
-template<class Deleg, class P1, class P2, class P3, class P4, class R>
-struct rt_invoker4 {
-	inline static void invoke(void ** args, void * rt, const Deleg& dlg) { if(rt) UP_RET() = dlg(UP_ARG(P1, 0), UP_ARG(P2, 1), UP_ARG(P3, 2), UP_ARG(P4, 3)); else dlg(UP_ARG(P1, 0), UP_ARG(P2, 1), UP_ARG(P3, 2), UP_ARG(P4, 3)); }
-};
-template<class Deleg, class P1, class P2, class P3, class P4>
-struct rt_invoker4<Deleg, P1, P2, P3, P4, void> {
-	inline static void invoke(void ** args, void * rt, const Deleg& dlg) { dlg(UP_ARG(P1, 0), UP_ARG(P2, 1), UP_ARG(P3, 2), UP_ARG(P4, 3)); }
-};
+protected:
+	explicit delegate_dynamic_base(const signature_desc *sig) : m_Signature(sig) { }
 
-template<class Deleg, class P1, class P2, class P3, class P4, class P5, class R>
-struct rt_invoker5 {
-	inline static void invoke(void ** args, void * rt, const Deleg& dlg) { if(rt) UP_RET() = dlg(UP_ARG(P1, 0), UP_ARG(P2, 1), UP_ARG(P3, 2), UP_ARG(P4, 3), UP_ARG(P5, 4)); else dlg(UP_ARG(P1, 0), UP_ARG(P2, 1), UP_ARG(P3, 2), UP_ARG(P4, 3), UP_ARG(P5, 4)); }
-};
-template<class Deleg, class P1, class P2, class P3, class P4, class P5>
-struct rt_invoker5<Deleg, P1, P2, P3, P4, P5, void> {
-	inline static void invoke(void ** args, void * rt, const Deleg& dlg) { dlg(UP_ARG(P1, 0), UP_ARG(P2, 1), UP_ARG(P3, 2), UP_ARG(P4, 3), UP_ARG(P5, 4)); }
+private:
+	const signature_desc *m_Signature;
 };
 
-#undef UP_ARG
-#undef UP_RET
-
 //////////////////////////////////////////////////////////////////////////
 
-//N=0
-template<typename R = void>
-class delegate_dynamic0 : public delegate0 < R >, public delegate_dynamic_base
-{
-public:
-	typedef delegate0 < R > base_type;
-	typedef delegate_dynamic0 this_type;
+#define UP_ARG(T, N)		(*(typename t_strip<T>::noref*)args[N])
+#define UP_RET()			(*(typename t_strip<R>::norefp*)rt)
+#define UP_COL(T, N)		(*(typename t_strip<T>::noref*)cols[N])
+#define UP_RET_AT(I)		(*(typename t_strip<R>::norefp*)(static_cast<char*>(rt) + (I) * rt_stride))
+#define UP_FRM(N)			(*layout::template at<N>(frame))
+#define UP_MOV(T, N)		std::forward<T>(UP_ARG(T, N))
+#define UP_NEW()			new (rt) typename std::remove_cv<typename t_strip<R>::norefp>::type
 
-	delegate_dynamic0() : base_type() { }
+// Unpacks argument array for the delegate call, Indices is index_list<0..N-1>.
+// The batched versions load the closure once and call it directly in the loop.
+template<class Deleg, class R, class Indices, class... Params>
+struct rt_invoker;
 
-	template < class X, class Y >
-	delegate_dynamic0(Y * pthis, R (X::* function_to_bind)(  ))
-		: base_type(pthis, function_to_bind)  
-	{ }
+FASTDLGT_BEGIN_MFP_TRICKS
 
-	template < class X, class Y >
-	delegate_dynamic0(const Y *pthis, R (X::* function_to_bind)(  ) const)
-		: base_type(pthis, function_to_bind)
-	{ }
-
-	delegate_dynamic0(R (*function_to_bind)(  ))
-		: base_type(function_to_bind) 
-	{ }
+template<class Deleg, class R, size_t... I, class... Params>
+struct rt_invoker<Deleg, R, detail::index_list<I...>, Params...> {
+	typedef delegate< R (Params...) > deleg_type;
+	typedef typename deleg_type::closure_type closure_type;
+	typedef frame_layout< R (Params...) > layout;
 
-	void operator = (const base_type &x)  { *static_cast<base_type*>(this) = x; }
+	inline static void invoke(void ** args, void * rt, const Deleg& dlg) { if(rt) UP_RET() = dlg(UP_ARG(Params, I)...); else dlg(UP_ARG(Params, I)...); }
+	inline static void invoke_frame(void * frame, void * rt, const Deleg& dlg) { (void)frame; if(rt) UP_RET() = dlg(UP_FRM(I)...); else dlg(UP_FRM(I)...); }
 
-	virtual void invoke(void ** args, void * ret) const
+	static void invoke_ex(void ** args, void * rt, unsigned mode, const Deleg& dlg)
 	{
-		rt_invoker0<this_type, R>::invoke(args, ret, *this);
+		bool move = (mode & invoke_move_args) != 0;
+		if(!rt)
+		{
+			if(move) dlg(UP_MOV(Params, I)...); else dlg(UP_ARG(Params, I)...);
+		}
+		else if(mode & invoke_construct_ret)
+		{
+			if(move) UP_NEW()(dlg(UP_MOV(Params, I)...)); else UP_NEW()(dlg(UP_ARG(Params, I)...));
+		}
+		else
+		{
+			if(move) UP_RET() = dlg(UP_MOV(Params, I)...); else UP_RET() = dlg(UP_ARG(Params, I)...);
+		}
 	}
 
-	virtual const detail::function_data& getFunctionData() { return base_type::getFunctionData(); }
+	static void invoke_rows(void *** rows, void * rt, size_t rt_stride, size_t count, const Deleg& dlg)
+	{
+		const closure_type &c = static_cast<const closure_type&>(static_cast<const deleg_type&>(dlg).getFunctionData());
+		auto pthis = c.GetClosureThis();
+		auto pfn = c.GetClosureMemPtr();
+		FASTDLGT_TIME_CALLS(c, count);
+		if(rt)
+			for(size_t i = 0; i != count; ++i) { void ** args = rows[i]; UP_RET_AT(i) = (pthis->*pfn)(UP_ARG(Params, I)...); }
+		else
+			for(size_t i = 0; i != count; ++i) { void ** args = rows[i]; (pthis->*pfn)(UP_ARG(Params, I)...); }
+	}
 
-	virtual void setFunctionData(const detail::function_data &any) { base_type::setFunctionData(any); }
+	static void invoke_columns(void ** bases, const size_t * strides, void * rt, size_t rt_stride, size_t count, const Deleg& dlg)
+	{
+		const closure_type &c = static_cast<const closure_type&>(static_cast<const deleg_type&>(dlg).getFunctionData());
+		auto pthis = c.GetClosureThis();
+		auto pfn = c.GetClosureMemPtr();
+		FASTDLGT_TIME_CALLS(c, count);
+		char * cols[sizeof...(Params) + 1] = { static_cast<char*>(bases[I])... };
+		for(size_t i = 0; i != count; ++i)
+		{
+			if(rt)
+				UP_RET_AT(i) = (pthis->*pfn)(UP_COL(Params, I)...);
+			else
+				(pthis->*pfn)(UP_COL(Params, I)...);
+			for(size_t n = 0; n != sizeof...(Params); ++n)
+				cols[n] += strides[n];
+		}
+	}
 };
+template<class Deleg, size_t... I, class... Params>
+struct rt_invoker<Deleg, void, detail::index_list<I...>, Params...> {
+	typedef delegate< void (Params...) > deleg_type;
+	typedef typename deleg_type::closure_type closure_type;
+	typedef frame_layout< void (Params...) > layout;
 
-//N=1
-template<class P1, typename R = void>
-class delegate_dynamic1 : public delegate1 < P1, R >, public delegate_dynamic_base
-{
-public:
-	typedef delegate1 < P1, R > base_type;
-	typedef delegate_dynamic1 this_type;
-
-	delegate_dynamic1() : base_type() { }
-
-	template < class X, class Y >
-	delegate_dynamic1(Y * pthis, R (X::* function_to_bind)( P1 p1 ))
-		: base_type(pthis, function_to_bind)  
-	{ }
+	inline static void invoke(void ** args, void * /*rt*/, const Deleg& dlg) { dlg(UP_ARG(Params, I)...); }
+	inline static void invoke_frame(void * frame, void * /*rt*/, const Deleg& dlg) { (void)frame; dlg(UP_FRM(I)...); }
 
-	template < class X, class Y >
-	delegate_dynamic1(const Y *pthis, R (X::* function_to_bind)( P1 p1 ) const)
-		: base_type(pthis, function_to_bind)
-	{ }
-
-	delegate_dynamic1(R (*function_to_bind)( P1 p1 ))
-		: base_type(function_to_bind)  
-	{ }
-
-	void operator = (const base_type &x)  { *static_cast<base_type*>(this) = x; }
-
-	virtual void invoke(void ** args, void * ret) const
+	static void invoke_ex(void ** args, void * /*rt*/, unsigned mode, const Deleg& dlg)
 	{
-		rt_invoker1<this_type, P1, R>::invoke(args, ret, *this);
+		if(mode & invoke_move_args) dlg(UP_MOV(Params, I)...); else dlg(UP_ARG(Params, I)...);
 	}
 
-	virtual const detail::function_data& getFunctionData() { return base_type::getFunctionData(); }
+	static void invoke_rows(void *** rows, void * /*rt*/, size_t /*rt_stride*/, size_t count, const Deleg& dlg)
+	{
+		const closure_type &c = static_cast<const closure_type&>(static_cast<const deleg_type&>(dlg).getFunctionData());
+		auto pthis = c.GetClosureThis();
+		auto pfn = c.GetClosureMemPtr();
+		FASTDLGT_TIME_CALLS(c, count);
+		for(size_t i = 0; i != count; ++i) { void ** args = rows[i]; (pthis->*pfn)(UP_ARG(Params, I)...); }
+	}
 
-	virtual void setFunctionData(const detail::function_data &any) { base_type::setFunctionData(any); }
+	static void invoke_columns(void ** bases, const size_t * strides, void * /*rt*/, size_t /*rt_stride*/, size_t count, const Deleg& dlg)
+	{
+		const closure_type &c = static_cast<const closure_type&>(static_cast<const deleg_type&>(dlg).getFunctionData());
+		auto pthis = c.GetClosureThis();
+		auto pfn = c.GetClosureMemPtr();
+		FASTDLGT_TIME_CALLS(c, count);
+		char * cols[sizeof...(Params) + 1] = { static_cast<char*>(bases[I])... };
+		for(size_t i = 0; i != count; ++i)
+		{
+			(pthis->*pfn)(UP_COL(Params, I)...);
+			for(size_t n = 0; n != sizeof...(Params); ++n)
+				cols[n] += strides[n];
+		}
+	}
 };
 
-//N=2
-template<class P1, class P2, typename R = void>
-class delegate_dynamic2 : public delegate2 < P1, P2, R >, public delegate_dynamic_base
-{
-public:
-	typedef delegate2 < P1, P2, R > base_type;
-	typedef delegate_dynamic2 this_type;
+FASTDLGT_END_MFP_TRICKS
 
-	delegate_dynamic2() : base_type() { }
+#undef UP_ARG
+#undef UP_RET
+#undef UP_COL
+#undef UP_RET_AT
+#undef UP_FRM
+#undef UP_MOV
+#undef UP_NEW
 
-	template < class X, class Y >
-	delegate_dynamic2(Y * pthis, R (X::* function_to_bind)( P1 p1, P2 p2 ))
-		: base_type(pthis, function_to_bind) 
-	{ }
+//////////////////////////////////////////////////////////////////////////
 
-	template < class X, class Y >
-	delegate_dynamic2(const Y *pthis, R (X::* function_to_bind)( P1 p1, P2 p2 ) const)
-		: base_type(pthis, function_to_bind)
-	{ }
+// Unpacking code shared by all signatures of one ABI class (see delegate_abi.h),
+// it calls the closure data through the delegate of the canonical signature.
+// The functions are kept out of line, otherwise every caller would get its own copy.
+template <typename Signature> struct folded_invoker;
 
-	delegate_dynamic2(R (*function_to_bind)( P1 p1, P2 p2 ))
-		: base_type(function_to_bind)  
-	{ }
+template<class R, class... Params>
+struct folded_invoker< R (Params...) >
+{
+	typedef delegate< R (Params...) > deleg_type;
+	typedef detail::delegate_view<deleg_type> view_type;
+	typedef rt_invoker<deleg_type, R, typename detail::make_index_list<sizeof...(Params)>::type, Params...> invoker_type;
 
-	void operator = (const base_type &x)  { *static_cast<base_type*>(this) = x; }
+	FASTDLGT_NOINLINE static void invoke(const detail::function_data &fd, void ** args, void * ret)
+	{
+		invoker_type::invoke(args, ret, view_type(fd).get());
+	}
 
-	virtual void invoke(void ** args, void * ret) const
+	FASTDLGT_NOINLINE static void invoke_ex(const detail::function_data &fd, void ** args, void * ret, unsigned mode)
 	{
-		rt_invoker2<this_type, P1, P2, R>::invoke(args, ret, *this);
+		invoker_type::invoke_ex(args, ret, mode, view_type(fd).get());
 	}
 
-	virtual const detail::function_data& getFunctionData() { return base_type::getFunctionData(); }
+	FASTDLGT_NOINLINE static void invoke_rows(const detail::function_data &fd, void *** rows, void * ret, size_t ret_stride, size_t count)
+	{
+		invoker_type::invoke_rows(rows, ret, ret_stride, count, view_type(fd).get());
+	}
 
-	virtual void setFunctionData(const detail::function_data &any) { base_type::setFunctionData(any); }
+	FASTDLGT_NOINLINE static void invoke_columns(const detail::function_data &fd, void ** bases, const size_t * strides, void * ret, size_t ret_stride, size_t count)
+	{
+		invoker_type::invoke_columns(bases, strides, ret, ret_stride, count, view_type(fd).get());
+	}
+
+	// The frame is laid out for the original signature, references have
+	// different slots there than in the canonical one
+	FASTDLGT_NOINLINE static void invoke_frame(const detail::function_data &fd, void * frame, void * ret, const size_t * offsets)
+	{
+		void * args[sizeof...(Params) + 1];
+		for(size_t i = 0; i != sizeof...(Params); ++i)
+			args[i] = static_cast<char*>(frame) + offsets[i];
+		invoker_type::invoke(args, ret, view_type(fd).get());
+	}
 };
 
-//N=3
-template<class P1, class P2, class P3, typename R = void>
-class delegate_dynamic3 : public delegate3 < P1, P2, P3, R >, public delegate_dynamic_base
+//////////////////////////////////////////////////////////////////////////
+
+template <typename Signature> class delegate_dynamic;
+
+template<class R, class... Params>
+class delegate_dynamic< R (Params...) > : public delegate< R (Params...) >, public delegate_dynamic_base
 {
 public:
-	typedef delegate3 < P1, P2, P3, R > base_type;
-	typedef delegate_dynamic3 this_type;
+	typedef delegate< R (Params...) > base_type;
+	typedef delegate_dynamic this_type;
+
+private:
+	typedef rt_invoker<this_type, R, typename detail::make_index_list<sizeof...(Params)>::type, Params...> invoker_type;
 
-	delegate_dynamic3() : base_type() { }
+public:
+	delegate_dynamic() : base_type(), delegate_dynamic_base(&signature_of< R (Params...) >::value) { }
 
 	template < class X, class Y >
-	delegate_dynamic3(Y * pthis, R (X::* function_to_bind)( P1 p1, P2 p2, P3 p3 ))
-		: base_type(pthis, function_to_bind)  
+	delegate_dynamic(Y * pthis, R (X::* function_to_bind)( Params... params ))
+		: base_type(pthis, function_to_bind), delegate_dynamic_base(&signature_of< R (Params...) >::value)
 	{ }
 
 	template < class X, class Y >
-	delegate_dynamic3(const Y *pthis, R (X::* function_to_bind)( P1 p1, P2 p2, P3 p3 ) const)
-		: base_type(pthis, function_to_bind)
+	delegate_dynamic(const Y *pthis, R (X::* function_to_bind)( Params... params ) const)
+		: base_type(pthis, function_to_bind), delegate_dynamic_base(&signature_of< R (Params...) >::value)
 	{ }
 
-	delegate_dynamic3(R (*function_to_bind)( P1 p1, P2 p2, P3 p3 ))
-		: base_type(function_to_bind)  
+	delegate_dynamic(R (*function_to_bind)( Params... params ))
+		: base_type(function_to_bind), delegate_dynamic_base(&signature_of< R (Params...) >::value)
 	{ }
 
 	void operator = (const base_type &x)  { *static_cast<base_type*>(this) = x; }
 
+#if defined(FASTDELEGATE_FOLD_ABI_SIGNATURES)
+	typedef folded_invoker<typename abi_signature< R (Params...) >::type> folded_type;
+
 	virtual void invoke(void ** args, void * ret) const
 	{
-		rt_invoker3<this_type, P1, P2, P3, R>::invoke(args, ret, *this);
+		folded_type::invoke(data(), args, ret);
 	}
 
-	virtual const detail::function_data& getFunctionData() { return base_type::getFunctionData(); }
-
-	virtual void setFunctionData(const detail::function_data &any) { base_type::setFunctionData(any); }
-};
+	virtual void invoke_ex(void ** args, void * ret, unsigned mode) const
+	{
+		folded_type::invoke_ex(data(), args, ret, mode);
+	}
 
-//N=4
-template<class P1, class P2, class P3, class P4, typename R = void>
-class delegate_dynamic4 : public delegate4 < P1, P2, P3, P4, R >, public delegate_dynamic_base
-{
-public:
-	typedef delegate4 < P1, P2, P3, P4, R > base_type;
-	typedef delegate_dynamic4 this_type;
+	virtual void invoke_batch(void *** arg_rows, void * ret_base, size_t ret_stride, size_t count) const
+	{
+		folded_type::invoke_rows(data(), arg_rows, ret_base, ret_stride, count);
+	}
 
-	delegate_dynamic4() : base_type() { }
+	virtual void invoke_batch_columns(void ** arg_bases, const size_t * arg_strides, void * ret_base, size_t ret_stride, size_t count) const
+	{
+		folded_type::invoke_columns(data(), arg_bases, arg_strides, ret_base, ret_stride, count);
+	}
 
-	template < class X, class Y >
-	delegate_dynamic4(Y * pthis, R (X::* function_to_bind)( P1 p1, P2 p2, P3 p3, P4 p4 ))
-		: base_type(pthis, function_to_bind)  
-	{ }
+	virtual void invoke_frame(void * frame, void * ret) const
+	{
+		folded_type::invoke_frame(data(), frame, ret, signature_of< R (Params...) >::value.frame_offsets);
+	}
+#else
+	virtual void invoke(void ** args, void * ret) const
+	{
+		invoker_type::invoke(args, ret, *this);
+	}
 
-	template < class X, class Y >
-	delegate_dynamic4(const Y *pthis, R (X::* function_to_bind)( P1 p1, P2 p2, P3 p3, P4 p4 ) const)
-		: base_type(pthis, function_to_bind)
-	{ }
+	virtual void invoke_ex(void ** args, void * ret, unsigned mode) const
+	{
+		invoker_type::invoke_ex(args, ret, mode, *this);
+	}
 
-	delegate_dynamic4(R (*function_to_bind)( P1 p1, P2 p2, P3 p3, P4 p4 ))
-		: base_type(function_to_bind)  
-	{ }
+	virtual void invoke_batch(void *** arg_rows, void * ret_base, size_t ret_stride, size_t count) const
+	{
+		invoker_type::invoke_rows(arg_rows, ret_base, ret_stride, count, *this);
+	}
 
-	void operator = (const base_type &x)  { *static_cast<base_type*>(this) = x; }
+	virtual void invoke_batch_columns(void ** arg_bases, const size_t * arg_strides, void * ret_base, size_t ret_stride, size_t count) const
+	{
+		invoker_type::invoke_columns(arg_bases, arg_strides, ret_base, ret_stride, count, *this);
+	}
 
-	virtual void invoke(void ** args, void * ret) const
+	virtual void invoke_frame(void * frame, void * ret) const
 	{
-		rt_invoker4<this_type, P1, P2, P3, P4, R>::invoke(args, ret, *this);
+		invoker_type::invoke_frame(frame, ret, *this);
 	}
+#endif
 
 	virtual const detail::function_data& getFunctionData() { return base_type::getFunctionData(); }
 
 	virtual void setFunctionData(const detail::function_data &any) { base_type::setFunctionData(any); }
+
+private:
+#if defined(FASTDELEGATE_FOLD_ABI_SIGNATURES)
+	const detail::function_data& data() const
+	{
+		(void)detail::fold_record< R (Params...) >::registered;
+		return base_type::getFunctionData();
+	}
+#endif
 };
 
-//N=5
-template<class P1, class P2, class P3, class P4, class P5, typename R = void>
-class delegate_dynamic5 : public delegate5 < P1, P2, P3, P4, P5, R >, public delegate_dynamic_base
+//////////////////////////////////////////////////////////////////////////
+
+// delegate_any is a value-type alternative to delegate_dynamic_base for code
+// which keeps lots of dynamically invoked handles. It stores the closure data
+// and a pointer to the typed unpacking thunk instead of a virtual table pointer,
+// so it is trivially copyable and invoke() is one plain indirect call:
+//
+//		delegate_any h(make_delegate(&obj, &Obj::SetValue));
+//		void* args[] = { &value };
+//		h.invoke(args, 0);
+//
+// The signature is erased, invoke() has the same (unchecked) contract
+// as delegate_dynamic_base::invoke().
+class delegate_any
 {
 public:
-	typedef delegate5 < P1, P2, P3, P4, P5, R > base_type;
-	typedef delegate_dynamic5 this_type;
+	typedef void (*invoker_type)(const detail::function_data &fd, void ** args, void * ret);
 
-	delegate_dynamic5() : base_type() { }
+	delegate_any() : m_Invoker(0) { }
 
-	template < class X, class Y >
-	delegate_dynamic5(Y * pthis, R (X::* function_to_bind)( P1 p1, P2 p2, P3 p3, P4 p4, P5 p5 ))
-		: base_type(pthis, function_to_bind)  
+	template<class R, class... Params>
+	delegate_any(const delegate< R (Params...) > &d)
+		: m_Data(d.getFunctionData()), m_Invoker(thunk_of<R, Params...>())
 	{ }
 
-	template < class X, class Y >
-	delegate_dynamic5(const Y *pthis, R (X::* function_to_bind)( P1 p1, P2 p2, P3 p3, P4 p4, P5 p5 ) const)
-		: base_type(pthis, function_to_bind)
+	template < class X, class Y, class R, class... Params >
+	delegate_any(Y * pthis, R (X::* function_to_bind)( Params... params ))
+		: m_Data(delegate< R (Params...) >(pthis, function_to_bind).getFunctionData()), m_Invoker(thunk_of<R, Params...>())
 	{ }
 
-	delegate_dynamic5(R (*function_to_bind)( P1 p1, P2 p2, P3 p3, P4 p4, P5 p5 ))
-		: base_type(function_to_bind)  
+	template < class X, class Y, class R, class... Params >
+	delegate_any(const Y *pthis, R (X::* function_to_bind)( Params... params ) const)
+		: m_Data(delegate< R (Params...) >(pthis, function_to_bind).getFunctionData()), m_Invoker(thunk_of<R, Params...>())
 	{ }
 
-	void operator = (const base_type &x)  { *static_cast<base_type*>(this) = x; }
+	template<class R, class... Params>
+	delegate_any(R (*function_to_bind)( Params... params ))
+		: m_Data(delegate< R (Params...) >(function_to_bind).getFunctionData()), m_Invoker(thunk_of<R, Params...>())
+	{ }
 
-	virtual void invoke(void ** args, void * ret) const
+	inline void invoke(void ** args, void * ret) const { m_Invoker(m_Data, args, ret); }
+
+	// Typed thunk the handle calls, equal for all handles of the same signature
+	// (of the same ABI class with FASTDELEGATE_FOLD_ABI_SIGNATURES)
+	invoker_type getInvoker() const { return m_Invoker; }
+	const detail::function_data& getFunctionData() const { return m_Data; }
+
+	bool empty() const { return m_Data.empty(); }
+	bool operator !() const { return m_Data.empty(); }
+	void clear() { m_Data.clear(); m_Invoker = 0; }
+
+	bool operator ==(const delegate_any &x) const { return m_Invoker == x.m_Invoker && m_Data.IsEqual(x.m_Data); }
+	bool operator !=(const delegate_any &x) const { return !(*this == x); }
+
+private:
+	// With FASTDELEGATE_FOLD_ABI_SIGNATURES all signatures of one ABI class share a thunk
+	template<class R, class... Params>
+	static invoker_type thunk_of()
 	{
-		rt_invoker5<this_type, P1, P2, P3, P4, P5, R>::invoke(args, ret, *this);
+#if defined(FASTDELEGATE_FOLD_ABI_SIGNATURES)
+		(void)detail::fold_record< R (Params...) >::registered;
+		return &folded_invoker<typename abi_signature< R (Params...) >::type>::invoke;
+#else
+		return &invoke_thunk<R, Params...>;
+#endif
 	}
 
-	virtual const detail::function_data& getFunctionData() { return base_type::getFunctionData(); }
+	// Unpacks the arguments for the typed delegate viewing the stored data
+	template<class R, class... Params>
+	static void invoke_thunk(const detail::function_data &fd, void ** args, void * ret)
+	{
+		typedef delegate< R (Params...) > deleg_type;
+		detail::delegate_view<deleg_type> dlg(fd);
+		rt_invoker<deleg_type, R, typename detail::make_index_list<sizeof...(Params)>::type, Params...>::invoke(args, ret, dlg.get());
+	}
 
-	virtual void setFunctionData(const detail::function_data &any) { base_type::setFunctionData(any); }
+	detail::function_data m_Data;
+	invoker_type m_Invoker;
 };
 
 //////////////////////////////////////////////////////////////////////////
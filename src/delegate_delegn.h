@@ -9,11 +9,11 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 // Once we have the member function conversion templates, it's easy to make the
-// wrapper classes. So that they will work with as many compilers as possible, 
-// the classes are of the form
-//   delegate3<int, char *, double>
-// They can cope with any combination of parameters. The max number of parameters
-// allowed is 8, but it is trivial to increase this limit.
+// wrapper classes. The class is of the form
+//   delegate<double (int, char *)>
+// and it can cope with any number and combination of parameters.
+// Numbered names like delegate2<int, char *, double> are aliases for it
+// (see delegate_funcstyle.h).
 // Note that we need to treat const member functions seperately.
 // All this class does is to enforce type safety, and invoke the delegate with
 // the correct list of parameters.
@@ -41,52 +41,196 @@
 
 namespace detail
 {
-	template<class RetType>
-	struct deleg_traits0
+	template<class R, class... Params> struct empty_sink;
+
+	template<class RetType, class... Params>
+	struct deleg_traits
 	{
-		typedef RetType(*StaticFunctionPtr)();
-		typedef RetType (detail::GenericClass::*GenericMemFn)();
+		typedef RetType (*StaticFunctionPtr)(Params... params);
+		typedef RetType (detail::GenericClass::*GenericMemFn)(Params... params);
 		typedef detail::closure_ptr<GenericMemFn, StaticFunctionPtr> ClosureType;
+		typedef empty_sink<RetType, Params...> EmptySink;
 	};
 
-	template<class P1, class RetType>
-	struct deleg_traits1
+	// How the static function invoker receives a parameter of type T.
+	// Itanium C++ ABI passes classes that are non-trivial for the purposes of
+	// calls as a pointer to a temporary which the caller creates and destroys,
+	// exactly like a reference. Taking such parameters by reference and calling
+	// the static function through the same signature lets it use the caller's
+	// temporary directly, so there's no copy or move on top of the one made at
+	// the call site. Only types that are surely non-trivial for calls
+	// (non-trivial destructor or user-provided copy constructor) are treated
+	// this way; all other parameters are forwarded (moved if passed by value).
+	template<class T>
+	struct passed_by_invisible_reference
 	{
-		typedef RetType (*StaticFunctionPtr)(P1 p1);
-		typedef RetType (detail::GenericClass::*GenericMemFn)(P1 p1);
-		typedef detail::closure_ptr<GenericMemFn, StaticFunctionPtr> ClosureType;
+#if defined(FASTDLGT_ITANIUM_ABI)
+		static const bool value = std::is_class<T>::value &&
+			(!std::is_trivially_destructible<T>::value ||
+			(std::is_copy_constructible<T>::value && !std::is_trivially_copy_constructible<T>::value));
+#else
+		static const bool value = false;
+#endif
 	};
 
-	template<class P1, class P2, class RetType>
-	struct deleg_traits2
+	template<class T, bool = passed_by_invisible_reference<T>::value>
+	struct static_param { typedef T type; };
+
+	template<class T>
+	struct static_param<T, true> { typedef T& type; };
+
+	// Result of a call to an empty delegate with FASTDELEGATE_EMPTY_SINK or
+	// to a dead weak_delegate<>. References and types without a default
+	// constructor can't be made up, for them the call throws std::bad_function_call.
+	template<class R, class = void>
+	struct empty_result { static R get() { throw std::bad_function_call(); } };
+
+	template<class R>
+	struct empty_result<R, typename std::enable_if<std::is_void<R>::value || std::is_default_constructible<R>::value>::type>
 	{
-		typedef RetType (*StaticFunctionPtr)(P1 p1, P2 p2);
-		typedef RetType (detail::GenericClass::*GenericMemFn)(P1 p1, P2 p2);
-		typedef detail::closure_ptr<GenericMemFn, StaticFunctionPtr> ClosureType;
+		static R get() { return R(); }
 	};
 
-	template<class P1, class P2, class P3, class RetType>
-	struct deleg_traits3
+	// The no-op empty delegates are bound to with FASTDELEGATE_EMPTY_SINK,
+	// called with detail::empty_sink_object() as 'this'. One per signature,
+	// the arguments are received like those of the static function invoker.
+	template<class R, class... Params>
+	struct empty_sink
 	{
-		typedef RetType (*StaticFunctionPtr)(P1 p1, P2 p2, P3 p3);
-		typedef RetType (detail::GenericClass::*GenericMemFn)(P1 p1, P2 p2, P3 p3);
-		typedef detail::closure_ptr<GenericMemFn, StaticFunctionPtr> ClosureType;
+		R call(typename static_param<Params>::type...) { return empty_result<R>::get(); }
 	};
 
-	template<class P1, class P2, class P3, class P4, class RetType>
-	struct deleg_traits4
+	// Calls a functor converting the result to R (or discarding it for void)
+	template<class R>
+	struct functor_call
 	{
-		typedef RetType (*StaticFunctionPtr)(P1 p1, P2 p2, P3 p3, P4 p4);
-		typedef RetType (detail::GenericClass::*GenericMemFn)(P1 p1, P2 p2, P3 p3, P4 p4);
-		typedef detail::closure_ptr<GenericMemFn, StaticFunctionPtr> ClosureType;
+		template<class F, class... Args>
+		static R call(F &f, Args&&... args) { return f(std::forward<Args>(args)...); }
 	};
 
-	template<class P1, class P2, class P3, class P4, class P5, class RetType>
-	struct deleg_traits5
+	template<>
+	struct functor_call<void>
 	{
-		typedef RetType (*StaticFunctionPtr)(P1 p1, P2 p2, P3 p3, P4 p4, P5 p5);
-		typedef RetType (detail::GenericClass::*GenericMemFn)(P1 p1, P2 p2, P3 p3, P4 p4, P5 p5);
-		typedef detail::closure_ptr<GenericMemFn, StaticFunctionPtr> ClosureType;
+		template<class F, class... Args>
+		static void call(F &f, Args&&... args) { f(std::forward<Args>(args)...); }
+	};
+
+	// Functor binding.
+	// If the functor has an operator() with exactly the delegate's signature
+	// it is bound directly, like any other method. Otherwise (generic lambdas,
+	// parameters which only convert, a different return type) the closure
+	// points to functor_thunk::call with the functor object as 'this'. The
+	// thunk has no data of its own, it just forwards to the functor's
+	// operator(), which normally gets inlined into it. By-value parameters
+	// are moved on, as free_target does.
+	template<class F, class R, class... Params>
+	struct functor_thunk
+	{
+		R call(typename static_param<Params>::type... params)
+		{
+			return functor_call<R>::call(*reinterpret_cast<F*>(this), std::forward<Params>(params)...);
+		}
+	};
+
+	// Compile-time targets (delegate<>::bind<Target>(), make_delegate<Target>()).
+	// The closure points to a thunk made for one target only, so the call
+	// inside the thunk is a direct call which the optimizer can inline, and
+	// a delegate which doesn't escape can be inlined all the way through.
+	// Free functions need no object, their thunk is a static function and
+	// bound like any other.
+	template<class R, class... Params>
+	struct free_target
+	{
+		template<R (*Function)(Params...)>
+		struct thunk
+		{
+			static R call(Params... params)
+			{
+				return Function(std::forward<Params>(params)...);
+			}
+		};
+	};
+
+	template<class X, class R, class... Params>
+	struct member_target
+	{
+		template<R (X::*Method)(Params...)>
+		struct thunk
+		{
+			R call(typename static_param<Params>::type... params)
+			{
+				return (reinterpret_cast<X*>(this)->*Method)(std::forward<Params>(params)...);
+			}
+		};
+
+		template<R (X::*Method)(Params...) const>
+		struct const_thunk
+		{
+			R call(typename static_param<Params>::type... params) const
+			{
+				return (reinterpret_cast<const X*>(this)->*Method)(std::forward<Params>(params)...);
+			}
+		};
+	};
+
+	// Signature and class of a target, used by make_delegate<Target>()
+	template<class T> struct target_traits;
+
+	template<class R, class... Params>
+	struct target_traits<R (*)(Params...)> { typedef R type(Params...); };
+
+	template<class X, class R, class... Params>
+	struct target_traits<R (X::*)(Params...)> { typedef R type(Params...); typedef X class_type; };
+
+	template<class X, class R, class... Params>
+	struct target_traits<R (X::*)(Params...) const> { typedef R type(Params...); typedef X class_type; };
+
+	// Selects operator() of exactly R (Params...) [const] if F has one.
+	// For a const F only the const operator is considered.
+	template<class F, class R, class... Params>
+	struct exact_call_operator
+	{
+		typedef typename std::remove_const<F>::type X;
+		typedef R (X::*mutable_ptr)(Params...);
+		typedef R (X::*const_ptr)(Params...) const;
+
+		template<class U, mutable_ptr> struct mutable_probe { };
+		template<class U, const_ptr> struct const_probe { };
+
+		template<class U> static char test_mutable(mutable_probe<U, &U::operator()>*);
+		template<class U> static long test_mutable(...);
+		template<class U> static char test_const(const_probe<U, &U::operator()>*);
+		template<class U> static long test_const(...);
+
+		static const bool is_const = sizeof(test_const<X>(0)) == 1;
+		static const bool is_mutable = !std::is_const<F>::value && sizeof(test_mutable<X>(0)) == 1;
+	};
+
+	// Functor types accepted by delegate<Sig>::bind(F&)
+	template<class F, class Delegate>
+	struct is_bindable_functor
+	{
+		typedef typename std::remove_const<F>::type X;
+		static const bool value = std::is_class<X>::value
+			&& !std::is_base_of<Delegate, X>::value;
+	};
+
+	// Signature of the functor's only operator(), used by make_delegate(F&)
+	template<class MemFn> struct call_operator_signature;
+
+	template<class X, class R, class... Params>
+	struct call_operator_signature<R (X::*)(Params...)> { typedef R type(Params...); };
+
+	template<class X, class R, class... Params>
+	struct call_operator_signature<R (X::*)(Params...) const> { typedef R type(Params...); };
+
+	template<class F, bool = std::is_class<F>::value>
+	struct functor_signature { };
+
+	template<class F>
+	struct functor_signature<F, true>
+	{
+		typedef typename call_operator_signature<decltype(&F::operator())>::type type;
 	};
 
 	//////////////////////////////////////////////////////////////////////////
@@ -102,9 +246,17 @@ namespace detail
 		typedef typename traits::ClosureType ClosureType;
 		ClosureType m_Closure;
 
+	public:
+		// Closure storage type, for containers that keep raw closures
+		// instead of whole delegate objects (see multicast_delegate)
+		typedef ClosureType closure_type;
+
+	protected:
 		delegate_n() { clear(); }
 		delegate_n(const delegate_n &x) { m_Closure.CopyFrom(this, x.m_Closure); }
 		void operator =(const delegate_n &x)  { m_Closure.CopyFrom(this, x.m_Closure); }
+
+	public:
 		bool operator ==(const delegate_n &x) const { return m_Closure.IsEqual(x.m_Closure);	}
 		bool operator !=(const delegate_n &x) const { return !m_Closure.IsEqual(x.m_Closure); }
 		bool operator <(const delegate_n &x) const { return m_Closure.IsLess(x.m_Closure);	}
@@ -125,271 +277,197 @@ namespace detail
 		inline bool operator!=(StaticFunctionPtr funcptr) { return !m_Closure.IsEqualToStaticFuncPtr(funcptr); }
 		inline bool operator !() const	{ return !m_Closure; }
 		inline bool empty() const { return !m_Closure; }
+#if defined(FASTDELEGATE_EMPTY_SINK)
+		void clear() {
+			typedef typename traits::EmptySink sink;
+			m_Closure.bindmemfunc(reinterpret_cast<sink*>(empty_sink_object()), &sink::call); }
+		// Conversion to and from the function_data storage class
+		const function_data & getFunctionData() const { return m_Closure; }
+		void setFunctionData(const function_data &any) {
+			if (any.empty()) clear();
+			else m_Closure.CopyFrom(this, any); }
+#else
 		void clear() { m_Closure.clear();}
 		// Conversion to and from the function_data storage class
-		const function_data & getFunctionData() { return m_Closure; }
+		const function_data & getFunctionData() const { return m_Closure; }
 		void setFunctionData(const function_data &any) { m_Closure.CopyFrom(this, any); }
+#endif
 	};
 }
 
 //////////////////////////////////////////////////////////////////////////
 
-//N=0
-template<class RetType = void>
-class delegate0 : public detail::delegate_n< detail::deleg_traits0<RetType> > 
+// Declare delegate as a class template. The only definition is the
+// specialization for function types: delegate< double (int, long) >
+template <typename Signature> class delegate;
+
+template<class RetType, class... Params>
+class delegate< RetType (Params...) > : public detail::delegate_n< detail::deleg_traits<RetType, Params...> > 
 {
+	typedef detail::delegate_n< detail::deleg_traits<RetType, Params...> > base;
+	typedef typename base::StaticFunctionPtr StaticFunctionPtr;
+
 public:
 	// Typedefs to aid generic programming
-	typedef delegate0 type;
+	typedef delegate type;
+	typedef delegate this_type;
+	typedef RetType result_type;
+	static const size_t arity = sizeof...(Params);
 
 	// Construction and comparison functions
-	delegate0() { }
-	delegate0(const delegate0 &x) : base(x) { }
-	void operator = (const delegate0 &x) { base::operator=(x); }
+	delegate() { }
+	delegate(const delegate &x) : base(x) { }
+	void operator = (const delegate &x) { base::operator=(x); }
 	// Binding to non-const member functions
 	template < class X, class Y >
-	delegate0(Y *pthis, RetType (X::* function_to_bind)() ) {
-		m_Closure.bindmemfunc(detail::implicit_cast<X*>(pthis), function_to_bind); }
+	delegate(Y *pthis, RetType (X::* function_to_bind)(Params... params) ) {
+		this->m_Closure.bindmemfunc(detail::implicit_cast<X*>(pthis), function_to_bind); }
 	template < class X, class Y >
-	inline void bind(Y *pthis, RetType (X::* function_to_bind)()) {
-		m_Closure.bindmemfunc(detail::implicit_cast<X*>(pthis), function_to_bind);	}
+	inline void bind(Y *pthis, RetType (X::* function_to_bind)(Params... params)) {
+		this->m_Closure.bindmemfunc(detail::implicit_cast<X*>(pthis), function_to_bind);	}
 	// Binding to const member functions.
 	template < class X, class Y >
-	delegate0(const Y *pthis, RetType (X::* function_to_bind)() const) {
-		m_Closure.bindconstmemfunc(detail::implicit_cast<const X*>(pthis), function_to_bind);	}
+	delegate(const Y *pthis, RetType (X::* function_to_bind)(Params... params) const) {
+		this->m_Closure.bindconstmemfunc(detail::implicit_cast<const X*>(pthis), function_to_bind);	}
 	template < class X, class Y >
-	inline void bind(const Y *pthis, RetType (X::* function_to_bind)() const) {
-		m_Closure.bindconstmemfunc(detail::implicit_cast<const X *>(pthis), function_to_bind);	}
+	inline void bind(const Y *pthis, RetType (X::* function_to_bind)(Params... params) const) {
+		this->m_Closure.bindconstmemfunc(detail::implicit_cast<const X *>(pthis), function_to_bind);	}
 	// Static functions. We convert them into a member function call.
 	// This constructor also provides implicit conversion
-	delegate0(RetType (*function_to_bind)() ) {
+	delegate(RetType (*function_to_bind)(Params... params) ) {
 		bind(function_to_bind);	}
 	// for efficiency, prevent creation of a temporary
-	void operator = (RetType (*function_to_bind)() ) {
+	void operator = (RetType (*function_to_bind)(Params... params) ) {
 		bind(function_to_bind);	}
-	inline void bind(RetType (*function_to_bind)()) {
-		m_Closure.bindstaticfunc(this, &delegate0::InvokeStaticFunction, 
+	inline void bind(RetType (*function_to_bind)(Params... params)) {
+		this->m_Closure.bindstaticfunc(this, &delegate::InvokeStaticFunction, 
 			function_to_bind); }
+	// Functors (lambdas, function objects). The delegate doesn't own the
+	// functor, which must outlive it. Only lvalues are accepted, so that
+	// a temporary can't be bound by accident (see delegate_ref for that).
+	template < class F >
+	delegate(F &functor, typename std::enable_if<detail::is_bindable_functor<F, delegate>::value>::type* = 0) {
+		bind(functor); }
+	template < class F >
+	inline typename std::enable_if<detail::is_bindable_functor<F, delegate>::value>::type bind(F &functor) {
+		typedef detail::exact_call_operator<F, RetType, Params...> probe;
+		bind_functor(functor, std::integral_constant<int, probe::is_mutable ? 1 : probe::is_const ? 2 : 0>()); }
+	// Compile-time targets, see detail::free_target. The delegate calls a thunk
+	// which calls the target directly:
+	//		d.bind<&F1>();
+	//		d.bind<Obj, &Obj::SetValue>(&obj);
+	// Such delegates compare equal to each other, but not to a delegate of the
+	// same target bound at run time. In C++17 make_delegate<&Obj::SetValue>(&obj)
+	// deduces the signature.
+	template < RetType (*Function)(Params... params) >
+	inline void bind() {
+		typedef typename detail::free_target<RetType, Params...>::template thunk<Function> thunk;
+		this->m_Closure.bindstaticfunc(this, &delegate::InvokeStaticFunction, &thunk::call); }
+	template < class X, RetType (X::* Method)(Params... params), class Y >
+	inline void bind(Y *pthis) {
+		typedef typename detail::member_target<X, RetType, Params...>::template thunk<Method> thunk;
+		this->m_Closure.bindmemfunc(reinterpret_cast<thunk*>(detail::implicit_cast<X*>(pthis)), &thunk::call); }
+	template < class X, RetType (X::* Method)(Params... params) const, class Y >
+	inline void bind(const Y *pthis) {
+		typedef typename detail::member_target<X, RetType, Params...>::template const_thunk<Method> thunk;
+		this->m_Closure.bindconstmemfunc(reinterpret_cast<const thunk*>(detail::implicit_cast<const X*>(pthis)), &thunk::call); }
 	// Invoke the delegate
-	RetType operator() () const { return (m_Closure.GetClosureThis()->*(m_Closure.GetClosureMemPtr()))(); }
-
-private:	// Invoker for static functions
-	RetType InvokeStaticFunction() const {
-		return (*(m_Closure.GetStaticFunction()))(); }
-};
-
-//N=1
-template<class P1, class RetType = void>
-class delegate1 : public detail::delegate_n< detail::deleg_traits1<P1, RetType> > 
-{
-public:
-	typedef delegate1 type;
-	delegate1() { }
-	delegate1(const delegate1 &x) : base(x) { }
-
-	template < class X, class Y >
-	delegate1(Y *pthis, RetType (X::* function_to_bind)(P1 p1) ) {
-		m_Closure.bindmemfunc(detail::implicit_cast<X*>(pthis), function_to_bind); }
-	template < class X, class Y >
-	inline void bind(Y *pthis, RetType (X::* function_to_bind)(P1 p1)) {
-		m_Closure.bindmemfunc(detail::implicit_cast<X*>(pthis), function_to_bind);	}
-	template < class X, class Y >
-	delegate1(const Y *pthis, RetType (X::* function_to_bind)(P1 p1) const) {
-		m_Closure.bindconstmemfunc(detail::implicit_cast<const X*>(pthis), function_to_bind);	}
-	template < class X, class Y >
-	inline void bind(const Y *pthis, RetType (X::* function_to_bind)(P1 p1) const) {
-		m_Closure.bindconstmemfunc(detail::implicit_cast<const X *>(pthis), function_to_bind);	}
-	delegate1(RetType (*function_to_bind)(P1 p1) ) {
-		bind(function_to_bind);	}
-	void operator = (RetType (*function_to_bind)(P1 p1) ) {
-		bind(function_to_bind);	}
-	inline void bind(RetType (*function_to_bind)(P1 p1)) {
-		m_Closure.bindstaticfunc(this, &delegate1::InvokeStaticFunction, 
-			function_to_bind); }
-	template<class Pf1>
-	RetType operator() (Pf1&& p1) const 
+FASTDLGT_BEGIN_MFP_TRICKS
+	template<class... Pf>
+	RetType operator() (Pf&&... params) const 
 	{ 
-		return (m_Closure.GetClosureThis()->*(m_Closure.GetClosureMemPtr()))(std::forward<Pf1>(p1)); 
+		FASTDLGT_TIME_CALLS(this->m_Closure, 1);
+		return (this->m_Closure.GetClosureThis()->*(this->m_Closure.GetClosureMemPtr()))(std::forward<Pf>(params)...); 
 	}
+FASTDLGT_END_MFP_TRICKS
+
+private:	// Functor binding, see detail::functor_thunk
+	typedef std::integral_constant<int, 0> functor_thunked;
+	typedef std::integral_constant<int, 1> functor_mutable_op;
+	typedef std::integral_constant<int, 2> functor_const_op;
+
+	template < class F >
+	inline void bind_functor(F &functor, functor_mutable_op) {
+		typedef typename detail::exact_call_operator<F, RetType, Params...>::mutable_ptr op_ptr;
+		this->m_Closure.bindmemfunc(&functor, static_cast<op_ptr>(&F::operator())); }
+	template < class F >
+	inline void bind_functor(F &functor, functor_const_op) {
+		typedef typename detail::exact_call_operator<F, RetType, Params...>::const_ptr op_ptr;
+		typedef typename std::remove_const<F>::type X;
+		this->m_Closure.bindconstmemfunc(static_cast<const X*>(&functor), static_cast<op_ptr>(&X::operator())); }
+	template < class F >
+	inline void bind_functor(F &functor, functor_thunked) {
+		typedef detail::functor_thunk<F, RetType, Params...> thunk;
+		this->m_Closure.bindmemfunc(reinterpret_cast<thunk*>(const_cast<typename std::remove_const<F>::type*>(&functor)), &thunk::call); }
 
 private:	// Invoker for static functions
-	RetType InvokeStaticFunction(P1 p1) const {
-		return (*(m_Closure.GetStaticFunction()))(p1); }
+	// It's called through GenericMemFn, so its parameters must be passed
+	// exactly like Params (see detail::static_param).
+	typedef RetType (*StaticInvokePtr)(typename detail::static_param<Params>::type... params);
+
+FASTDLGT_BEGIN_MFP_TRICKS
+	RetType InvokeStaticFunction(typename detail::static_param<Params>::type... params) const {
+		return (*reinterpret_cast<StaticInvokePtr>(this->m_Closure.GetStaticFunction()))(
+			std::forward<typename detail::static_param<Params>::type>(params)...); }
+FASTDLGT_END_MFP_TRICKS
 };
 
-//N=2
-template<class P1, class P2, class RetType = void>
-class delegate2 : public detail::delegate_n< detail::deleg_traits2<P1, P2, RetType> >
+namespace detail
 {
-public:
-	typedef delegate2 type;
+	// Typed access to closure data kept outside of a delegate (type-erased
+	// handles, queues). With the static function hack a delegate is nothing
+	// but its function_data and is viewed in place, otherwise a copy is
+	// restored so the self-reference of a static function gets rebased.
+	template<class Deleg>
+	class delegate_view
+	{
+	public:
+#if defined(FASTDELEGATE_USESTATICFUNCTIONHACK)
+		explicit delegate_view(const function_data &fd) : m_Deleg(reinterpret_cast<const Deleg&>(fd))
+		{
+			static_assert(sizeof(Deleg) == sizeof(function_data), "Can't use this optimization method");
+		}
+		const Deleg& get() const { return m_Deleg; }
 
-	delegate2() { }
-	delegate2(const delegate2 &x) : base(x) { }
-	void operator = (const delegate2 &x)  { base::operator=(x); }
+	private:
+		const Deleg &m_Deleg;
+#else
+		explicit delegate_view(const function_data &fd) { m_Deleg.setFunctionData(fd); }
+		const Deleg& get() const { return m_Deleg; }
 
-	template < class X, class Y >
-	delegate2(Y *pthis, RetType (X::* function_to_bind)(P1 p1, P2 p2) ) {
-		m_Closure.bindmemfunc(detail::implicit_cast<X*>(pthis), function_to_bind); }
-	template < class X, class Y >
-	inline void bind(Y *pthis, RetType (X::* function_to_bind)(P1 p1, P2 p2)) {
-		m_Closure.bindmemfunc(detail::implicit_cast<X*>(pthis), function_to_bind);	}
-	template < class X, class Y >
-	delegate2(const Y *pthis, RetType (X::* function_to_bind)(P1 p1, P2 p2) const) {
-		m_Closure.bindconstmemfunc(detail::implicit_cast<const X*>(pthis), function_to_bind);	}
-	template < class X, class Y >
-	inline void bind(const Y *pthis, RetType (X::* function_to_bind)(P1 p1, P2 p2) const) {
-		m_Closure.bindconstmemfunc(detail::implicit_cast<const X *>(pthis), function_to_bind);	}
-	delegate2(RetType (*function_to_bind)(P1 p1, P2 p2) ) {
-		bind(function_to_bind);	}
-	void operator = (RetType (*function_to_bind)(P1 p1, P2 p2) ) {
-		bind(function_to_bind);	}
-	inline void bind(RetType (*function_to_bind)(P1 p1, P2 p2)) {
-		m_Closure.bindstaticfunc(this, &delegate2::InvokeStaticFunction, 
-			function_to_bind); }
-	template<class Pf1, class Pf2>
-	RetType operator() (Pf1&& p1, Pf2&& p2) const 
-	{ 
-		return (m_Closure.GetClosureThis()->*(m_Closure.GetClosureMemPtr()))(
-			std::forward<Pf1>(p1),
-			std::forward<Pf2>(p2)); 
-	}
+	private:
+		Deleg m_Deleg;
+#endif
+	};
+}
 
-private:
-	RetType InvokeStaticFunction(P1 p1, P2 p2) const {
-		return (*(m_Closure.GetStaticFunction()))(p1, p2); }
-};
+//////////////////////////////////////////////////////////////////////////
 
-//N=3
-template<class P1, class P2, class P3, class RetType = void>
-class delegate3 : public detail::delegate_n< detail::deleg_traits3<P1, P2, P3, RetType> >
-{
-public:
-	typedef delegate3 type;
+// delegate_ref<> is a delegate meant to be used as a parameter type for
+// callbacks which are only called during the call they're passed to
+// (visitors, comparators, iteration callbacks). Unlike delegate<> it binds
+// temporaries too, so a lambda can be passed directly:
+//		void for_each_child(delegate_ref< void (Node&) > fn);
+//		for_each_child([&](Node& n) { ++count; });
+// The temporary lives until the end of the full expression, so delegate_ref
+// must not be stored anywhere.
 
-	delegate3() { }
-	delegate3(const delegate3 &x) : base(x) { }
-	void operator = (const delegate3 &x)  { base::operator=(x); }
-	template < class X, class Y >
-	delegate3(Y *pthis, RetType (X::* function_to_bind)(P1 p1, P2 p2, P3 p3) ) {
-		m_Closure.bindmemfunc(detail::implicit_cast<X*>(pthis), function_to_bind); }
-	template < class X, class Y >
-	inline void bind(Y *pthis, RetType (X::* function_to_bind)(P1 p1, P2 p2, P3 p3)) {
-		m_Closure.bindmemfunc(detail::implicit_cast<X*>(pthis), function_to_bind);	}
-	template < class X, class Y >
-	delegate3(const Y *pthis, RetType (X::* function_to_bind)(P1 p1, P2 p2, P3 p3) const) {
-		m_Closure.bindconstmemfunc(detail::implicit_cast<const X*>(pthis), function_to_bind);	}
-	template < class X, class Y >
-	inline void bind(const Y *pthis, RetType (X::* function_to_bind)(P1 p1, P2 p2, P3 p3) const) {
-		m_Closure.bindconstmemfunc(detail::implicit_cast<const X *>(pthis), function_to_bind);	}
-	delegate3(RetType (*function_to_bind)(P1 p1, P2 p2, P3 p3) ) {
-		bind(function_to_bind);	}
-	void operator = (RetType (*function_to_bind)(P1 p1, P2 p2, P3 p3) ) {
-		bind(function_to_bind);	}
-	inline void bind(RetType (*function_to_bind)(P1 p1, P2 p2, P3 p3)) {
-		m_Closure.bindstaticfunc(this, &delegate3::InvokeStaticFunction, 
-			function_to_bind); }
-	template<class Pf1, class Pf2, class Pf3>
-	RetType operator() (Pf1&& p1, Pf2&& p2, Pf3&& p3) const 
-	{ 
-		return (m_Closure.GetClosureThis()->*(m_Closure.GetClosureMemPtr()))(
-			std::forward<Pf1>(p1),
-			std::forward<Pf2>(p2),
-			std::forward<Pf3>(p3)); 
-	}
-
-private:
-	RetType InvokeStaticFunction(P1 p1, P2 p2, P3 p3) const {
-		return (*(m_Closure.GetStaticFunction()))(p1, p2, p3); }
-};
+template <typename Signature> class delegate_ref;
 
-//N=4
-template<class P1, class P2, class P3, class P4, class RetType = void>
-class delegate4 : public detail::delegate_n< detail::deleg_traits4<P1, P2, P3, P4, RetType> >
+template<class RetType, class... Params>
+class delegate_ref< RetType (Params...) > : public delegate< RetType (Params...) >
 {
-public:
-	typedef delegate4 type;
-
-	delegate4() { }
-	delegate4(const delegate4 &x) : base(x) { }
-	void operator = (const delegate4 &x)  { base::operator=(x); }
-	template < class X, class Y >
-	delegate4(Y *pthis, RetType (X::* function_to_bind)(P1 p1, P2 p2, P3 p3, P4 p4) ) {
-		m_Closure.bindmemfunc(detail::implicit_cast<X*>(pthis), function_to_bind); }
-	template < class X, class Y >
-	inline void bind(Y *pthis, RetType (X::* function_to_bind)(P1 p1, P2 p2, P3 p3, P4 p4)) {
-		m_Closure.bindmemfunc(detail::implicit_cast<X*>(pthis), function_to_bind);	}
-	template < class X, class Y >
-	delegate4(const Y *pthis, RetType (X::* function_to_bind)(P1 p1, P2 p2, P3 p3, P4 p4) const) {
-		m_Closure.bindconstmemfunc(detail::implicit_cast<const X*>(pthis), function_to_bind);	}
-	template < class X, class Y >
-	inline void bind(const Y *pthis, RetType (X::* function_to_bind)(P1 p1, P2 p2, P3 p3, P4 p4) const) {
-		m_Closure.bindconstmemfunc(detail::implicit_cast<const X *>(pthis), function_to_bind);	}
-	delegate4(RetType (*function_to_bind)(P1 p1, P2 p2, P3 p3, P4 p4) ) {
-		bind(function_to_bind);	}
-	void operator = (RetType (*function_to_bind)(P1 p1, P2 p2, P3 p3, P4 p4) ) {
-		bind(function_to_bind);	}
-	inline void bind(RetType (*function_to_bind)(P1 p1, P2 p2, P3 p3, P4 p4)) {
-		m_Closure.bindstaticfunc(this, &delegate4::InvokeStaticFunction, 
-			function_to_bind); }
-	template<class Pf1, class Pf2, class Pf3, class Pf4>
-	RetType operator() (Pf1&& p1, Pf2&& p2, Pf3&& p3, Pf4&& p4) const 
-	{ 
-		return (m_Closure.GetClosureThis()->*(m_Closure.GetClosureMemPtr()))(
-			std::forward<Pf1>(p1),
-			std::forward<Pf2>(p2),
-			std::forward<Pf3>(p3),
-			std::forward<Pf4>(p4)); 
-	}
-
-private:
-	RetType InvokeStaticFunction(P1 p1, P2 p2, P3 p3, P4 p4) const {
-		return (*(m_Closure.GetStaticFunction()))(p1, p2, p3, p4); }
-};
+	typedef delegate< RetType (Params...) > base;
 
-//N=5
-template<class P1, class P2, class P3, class P4, class P5, class RetType = void>
-class delegate5 : public detail::delegate_n< detail::deleg_traits5<P1, P2, P3, P4, P5, RetType> >
-{
 public:
-	typedef delegate5 type;
-
-	delegate5() { }
-	delegate5(const delegate5 &x) : base(x) { }
-	void operator = (const delegate5 &x)  { base::operator=(x); }
-	template < class X, class Y >
-	delegate5(Y *pthis, RetType (X::* function_to_bind)(P1 p1, P2 p2, P3 p3, P4 p4, P5 p5) ) {
-		m_Closure.bindmemfunc(detail::implicit_cast<X*>(pthis), function_to_bind); }
-	template < class X, class Y >
-	inline void bind(Y *pthis, RetType (X::* function_to_bind)(P1 p1, P2 p2, P3 p3, P4 p4, P5 p5)) {
-		m_Closure.bindmemfunc(detail::implicit_cast<X*>(pthis), function_to_bind);	}
-	template < class X, class Y >
-	delegate5(const Y *pthis, RetType (X::* function_to_bind)(P1 p1, P2 p2, P3 p3, P4 p4, P5 p5) const) {
-		m_Closure.bindconstmemfunc(detail::implicit_cast<const X*>(pthis), function_to_bind);	}
-	template < class X, class Y >
-	inline void bind(const Y *pthis, RetType (X::* function_to_bind)(P1 p1, P2 p2, P3 p3, P4 p4, P5 p5) const) {
-		m_Closure.bindconstmemfunc(detail::implicit_cast<const X *>(pthis), function_to_bind);	}
-	delegate5(RetType (*function_to_bind)(P1 p1, P2 p2, P3 p3, P4 p4, P5 p5) ) {
-		bind(function_to_bind);	}
-	void operator = (RetType (*function_to_bind)(P1 p1, P2 p2, P3 p3, P4 p4, P5 p5) ) {
-		bind(function_to_bind);	}
-	inline void bind(RetType (*function_to_bind)(P1 p1, P2 p2, P3 p3, P4 p4, P5 p5)) {
-		m_Closure.bindstaticfunc(this, &delegate5::InvokeStaticFunction, 
-			function_to_bind); }
-	template<class Pf1, class Pf2, class Pf3, class Pf4, class Pf5>
-	RetType operator() (Pf1&& p1, Pf2&& p2, Pf3&& p3, Pf4&& p4, Pf5&& p5) const 
-	{ 
-		return (m_Closure.GetClosureThis()->*(m_Closure.GetClosureMemPtr()))(
-			std::forward<Pf1>(p1),
-			std::forward<Pf2>(p2),
-			std::forward<Pf3>(p3),
-			std::forward<Pf4>(p4),
-			std::forward<Pf5>(p5)); 
-	}
-
-private:
-	RetType InvokeStaticFunction(P1 p1, P2 p2, P3 p3, P4 p4, P5 p5) const {
-		return (*(m_Closure.GetStaticFunction()))(p1, p2, p3, p4, p5); }
+	typedef delegate_ref type;
+	typedef base delegate_type;
+
+	delegate_ref(const delegate_type &x) : base(x) { }
+	delegate_ref(RetType (*function_to_bind)(Params... params) ) : base(function_to_bind) { }
+	template < class F >
+	delegate_ref(F &&functor, typename std::enable_if<detail::is_bindable_functor<typename std::remove_reference<F>::type, base>::value>::type* = 0) {
+		this->bind(functor); }
 };
 
 #endif //_DELEGATE_DELEGN_H__
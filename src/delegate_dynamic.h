@@ -1,6 +1,15 @@
 #ifndef _SF_DELEGATE_DYNAMIC_H__
 #define _SF_DELEGATE_DYNAMIC_H__
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
 namespace delegates
 {
 
@@ -9,7 +18,7 @@ namespace delegates
 #include "delegate_closure.h"
 #include "delegate_deleg_dynn.h"
 
-// Generate function-style delegate for zero-overhead and dynamic versions of delegates
+// Generate numbered aliases for zero-overhead and dynamic versions of delegates
 #define FS_DELEGATE delegate_dynamic
 #define DELEGATE(n) delegate_dynamic##n
 #	include "delegate_funcstyle.h"
@@ -18,14 +27,14 @@ namespace delegates
 
 // Generate both const and non-const versions of ordinary zero-overhead delegate makers
 #define DELEG_CONST
-#define DELEGATE(n) delegate_dynamic##n
+#define FS_DELEGATE delegate_dynamic
 #define MAKE_DELEGATE make_delegate_dynamic
 #	include "delegate_makedeleg.h"
 #undef DELEG_CONST
 #define DELEG_CONST const
 #	include "delegate_makedeleg.h"
 #undef MAKE_DELEGATE
-#undef DELEGATE
+#undef FS_DELEGATE
 #undef DELEG_CONST
 
 
@@ -34,6 +43,40 @@ delegate_dynamic<FT> make_delegate_dynamic(FT* f) {
 	return delegate_dynamic<FT>(f);
 }
 
+#if defined(FASTDLGT_HAS_AUTO_TEMPLATE_PARAMS)
+// Compile-time targets, see delegate<>::bind<Target>()
+template<auto Target>
+delegate_dynamic<typename detail::target_traits<decltype(Target)>::type> make_delegate_dynamic() {
+	delegate_dynamic<typename detail::target_traits<decltype(Target)>::type> d;
+	d.template bind<Target>();
+	return d;
+}
+
+template<auto Target, class Y>
+delegate_dynamic<typename detail::target_traits<decltype(Target)>::type> make_delegate_dynamic(Y *pthis) {
+	delegate_dynamic<typename detail::target_traits<decltype(Target)>::type> d;
+	d.template bind<typename detail::target_traits<decltype(Target)>::class_type, Target>(pthis);
+	return d;
+}
+#endif
+
+}
+
+#include "delegate_hash.h"
+
+namespace std
+{
+	template<class Signature>
+	struct hash< delegates::delegate_dynamic<Signature> >
+	{
+		size_t operator()(const delegates::delegate_dynamic<Signature> &x) const { return x.base_type::getFunctionData().GetHash(); }
+	};
+
+	template<>
+	struct hash<delegates::delegate_any>
+	{
+		size_t operator()(const delegates::delegate_any &x) const { return x.getFunctionData().GetHash(); }
+	};
 }
 
 #endif //_SF_DELEGATE_DYNAMIC_H__
\ No newline at end of file
@@ -0,0 +1,602 @@
+#ifndef _SF_DELEGATE_EXECUTOR_H__
+#define _SF_DELEGATE_EXECUTOR_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "delegate.h"
+
+namespace delegates
+{
+
+//////////////////////////////////////////////////////////////////////////
+// Asynchronous invocation
+//////////////////////////////////////////////////////////////////////////
+
+// delegate_executor runs delegates with bound arguments on a fixed pool
+// of threads and hands out a task_future<> for the result:
+//
+//		delegate_executor pool;
+//		task_future<int> f = pool.submit(make_delegate(&obj, &Obj::Compute), 10, name);
+//		...
+//		int v = f.get();
+//
+// Every worker has its own lock-free deque. Tasks submitted by a worker go
+// to its own deque and are taken back LIFO (they are still warm in cache),
+// idle workers steal FIFO from the other end of someone else's deque. Tasks
+// submitted from outside the pool are pushed round-robin onto the workers'
+// inboxes, lock-free lists a worker moves into its deque all at once. A task
+// is one allocation holding the delegate, the arguments, the result and the
+// state shared with the future.
+//
+// Waiting for a task blocks on the task's status with atomic::wait under
+// C++20. Before that waiters share a few condition variables picked by the
+// task's address.
+//
+// Arguments are copied (or moved) into the task. Reference parameters of the
+// delegate refer to that copy.
+//
+// A task can be cancelled until a worker starts running it. Destroying the
+// executor runs all tasks still queued and joins the workers.
+
+class task_cancelled : public std::exception
+{
+public:
+	virtual const char* what() const throw() { return "task was cancelled"; }
+};
+
+class delegate_executor;
+
+namespace detail
+{
+	enum task_status { task_is_pending, task_is_running, task_is_done, task_is_cancelled };
+
+#if !defined(__cpp_lib_atomic_wait)
+	// Without atomic::wait a task's waiters block on one of these, picked by
+	// the address of the task, so a finishing task wakes few other waiters.
+	struct task_waiters
+	{
+		std::mutex lock;
+		std::condition_variable finished;
+	};
+
+	inline task_waiters& get_task_waiters(const void *task)
+	{
+		static task_waiters waiters[16];
+		return waiters[hash_mix(reinterpret_cast<uintptr_t>(task)) & 15];
+	}
+#endif
+
+	class task_node
+	{
+	public:
+		// One reference for the queue, one for the future
+		task_node() : m_Refs(2), m_Status(task_is_pending), m_Waited(false), m_NextQueued(0) { }
+		virtual ~task_node() { }
+
+		void release()
+		{
+			if(m_Refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				destroy();
+		}
+
+		void run()
+		{
+			int expected = task_is_pending;
+			if(!m_Status.compare_exchange_strong(expected, task_is_running))
+				return;
+
+			try { execute(); }
+			catch(...) { m_Error = std::current_exception(); }
+			finish(task_is_done);
+		}
+
+		bool cancel()
+		{
+			int expected = task_is_pending;
+			if(!m_Status.compare_exchange_strong(expected, task_is_cancelled))
+				return false;
+			finish(task_is_cancelled);
+			return true;
+		}
+
+		int status() const { return m_Status.load(); }
+		bool finished() const { int s = m_Status.load(); return s == task_is_done || s == task_is_cancelled; }
+
+		// Only tasks which have a waiter notify when they finish, so the
+		// common case costs one flag load
+		void wait()
+		{
+			if(finished())
+				return;
+
+			m_Waited.store(true);
+#if defined(__cpp_lib_atomic_wait)
+			for(int s = m_Status.load(); s == task_is_pending || s == task_is_running; s = m_Status.load())
+				m_Status.wait(s);
+#else
+			task_waiters &w = get_task_waiters(this);
+			std::unique_lock<std::mutex> l(w.lock);
+			while(!finished())
+				w.finished.wait(l);
+#endif
+		}
+
+	protected:
+		virtual void execute() = 0;
+
+		// Called when the last reference is gone, the node isn't touched afterwards.
+		// Nodes which aren't allocated by the executor override it (see delegate_coro.h).
+		virtual void destroy() { delete this; }
+
+		// Waits and throws if the task didn't produce a value
+		void check_result()
+		{
+			wait();
+			if(m_Status.load() == task_is_cancelled)
+				throw task_cancelled();
+			if(m_Error)
+				std::rethrow_exception(m_Error);
+		}
+
+	private:
+		friend class delegates::delegate_executor;
+
+		task_node(const task_node &);
+		void operator = (const task_node &);
+
+		void finish(int status)
+		{
+			m_Status.store(status);
+			if(m_Waited.load())
+			{
+#if defined(__cpp_lib_atomic_wait)
+				m_Status.notify_all();
+#else
+				task_waiters &w = get_task_waiters(this);
+				std::lock_guard<std::mutex> l(w.lock);
+				w.finished.notify_all();
+#endif
+			}
+		}
+
+		std::atomic<int> m_Refs;
+		std::atomic<int> m_Status;
+		std::atomic<bool> m_Waited;
+		std::exception_ptr m_Error;
+		task_node *m_NextQueued;	// in an executor's inbox
+	};
+
+	// Result storage of a task
+	template<class R>
+	class task_state : public task_node
+	{
+	public:
+		task_state() : m_HasValue(false) { }
+		~task_state() { if(m_HasValue) value()->~R(); }
+
+		R get()
+		{
+			check_result();
+			return std::move(*value());
+		}
+
+	protected:
+		template<class V>
+		void set_value(V &&v)
+		{
+			new (&m_Storage) R(std::forward<V>(v));
+			m_HasValue = true;
+		}
+
+	private:
+		R* value() { return reinterpret_cast<R*>(&m_Storage); }
+
+		typename std::aligned_storage<sizeof(R), std::alignment_of<R>::value>::type m_Storage;
+		bool m_HasValue;
+	};
+
+	template<class R>
+	class task_state<R&> : public task_node
+	{
+	public:
+		task_state() : m_Value(0) { }
+
+		R& get()
+		{
+			check_result();
+			return *m_Value;
+		}
+
+	protected:
+		void set_value(R &v) { m_Value = &v; }
+
+	private:
+		R *m_Value;
+	};
+
+	template<>
+	class task_state<void> : public task_node
+	{
+	public:
+		void get() { check_result(); }
+	};
+
+	// Bound arguments are passed as lvalues to reference parameters and moved otherwise
+	template<class P, class T>
+	typename std::conditional<std::is_lvalue_reference<P>::value, T&, T&&>::type bound_arg(T &v)
+	{
+		return static_cast<typename std::conditional<std::is_lvalue_reference<P>::value, T&, T&&>::type>(v);
+	}
+
+	template<class R, class Signature, class Indices, class... Args>
+	class task_call;
+
+	template<class R, class... Params, size_t... I, class... Args>
+	class task_call<R, R (Params...), index_list<I...>, Args...> : public task_state<R>
+	{
+	public:
+		template<class... A>
+		task_call(const delegate< R (Params...) > &d, A&&... args) : m_Delegate(d), m_Args(std::forward<A>(args)...) { }
+
+	protected:
+		virtual void execute() { this->set_value(m_Delegate(bound_arg<Params>(std::get<I>(m_Args))...)); }
+
+	private:
+		delegate< R (Params...) > m_Delegate;
+		std::tuple<Args...> m_Args;
+	};
+
+	template<class... Params, size_t... I, class... Args>
+	class task_call<void, void (Params...), index_list<I...>, Args...> : public task_state<void>
+	{
+	public:
+		template<class... A>
+		task_call(const delegate< void (Params...) > &d, A&&... args) : m_Delegate(d), m_Args(std::forward<A>(args)...) { }
+
+	protected:
+		virtual void execute() { m_Delegate(bound_arg<Params>(std::get<I>(m_Args))...); }
+
+	private:
+		delegate< void (Params...) > m_Delegate;
+		std::tuple<Args...> m_Args;
+	};
+
+	// Work-stealing deque of Chase and Lev, in the formulation for weak memory
+	// models by Le, Pop, Cohen and Zappa Nardelli. Only the owning worker
+	// pushes and pops, at the bottom. Any thread may steal from the top, the
+	// owner only competes with thieves for the last task. The ring doubles
+	// when it is full. Thieves may still be reading the replaced ring, so
+	// it is only freed with the deque.
+	class task_deque
+	{
+	public:
+		task_deque() : m_Top(0), m_Bottom(0)
+		{
+			m_Rings.push_back(std::unique_ptr<ring>(new ring(64)));
+			m_Ring.store(m_Rings.back().get(), std::memory_order_relaxed);
+		}
+
+		// Owner only
+		void push(task_node *task)
+		{
+			int64_t b = m_Bottom.load(std::memory_order_relaxed);
+			int64_t t = m_Top.load(std::memory_order_acquire);
+			ring *r = m_Ring.load(std::memory_order_relaxed);
+			if(b - t > static_cast<int64_t>(r->mask))
+				r = grow(r, t, b);
+			r->at(b).store(task, std::memory_order_relaxed);
+			m_Bottom.store(b + 1, std::memory_order_release);
+		}
+
+		// Owner only, the most recently pushed task
+		task_node* pop()
+		{
+			int64_t b = m_Bottom.load(std::memory_order_relaxed) - 1;
+			ring *r = m_Ring.load(std::memory_order_relaxed);
+			m_Bottom.store(b, std::memory_order_seq_cst);
+			int64_t t = m_Top.load(std::memory_order_seq_cst);
+			if(t > b)
+			{
+				m_Bottom.store(b + 1, std::memory_order_release);
+				return 0;
+			}
+
+			task_node *task = r->at(b).load(std::memory_order_relaxed);
+			if(t == b)
+			{
+				// The last one, thieves may be taking it too
+				if(!m_Top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+					task = 0;
+				m_Bottom.store(b + 1, std::memory_order_release);
+			}
+			return task;
+		}
+
+		// Any thread, the oldest task. Returns 0 when empty or when another
+		// thread took the task first.
+		task_node* steal()
+		{
+			int64_t t = m_Top.load(std::memory_order_seq_cst);
+			int64_t b = m_Bottom.load(std::memory_order_seq_cst);
+			if(t >= b)
+				return 0;
+
+			task_node *task = m_Ring.load(std::memory_order_acquire)->at(t).load(std::memory_order_relaxed);
+			if(!m_Top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				return 0;
+			return task;
+		}
+
+	private:
+		task_deque(const task_deque &);
+		void operator = (const task_deque &);
+
+		struct ring
+		{
+			explicit ring(size_t capacity) : mask(capacity - 1), slots(new std::atomic<task_node*>[capacity]()) { }
+			std::atomic<task_node*>& at(int64_t i) { return slots[static_cast<size_t>(i) & mask]; }
+
+			const size_t mask;
+			std::unique_ptr< std::atomic<task_node*>[] > slots;
+		};
+
+		ring* grow(ring *old, int64_t t, int64_t b)
+		{
+			ring *r = new ring((old->mask + 1) * 2);
+			m_Rings.push_back(std::unique_ptr<ring>(r));
+			for(int64_t i = t; i != b; ++i)
+				r->at(i).store(old->at(i).load(std::memory_order_relaxed), std::memory_order_relaxed);
+			m_Ring.store(r, std::memory_order_release);
+			return r;
+		}
+
+		std::atomic<int64_t> m_Top;
+		char m_Padding[CACHE_LINE_SIZE];
+		std::atomic<int64_t> m_Bottom;
+		std::atomic<ring*> m_Ring;
+		std::vector< std::unique_ptr<ring> > m_Rings;	// the current one and all it replaced
+	};
+
+	// Executor and index of the worker running on the calling thread
+	struct executor_worker
+	{
+		const delegate_executor *owner;
+		size_t index;
+	};
+
+	inline executor_worker& current_executor_worker()
+	{
+		static thread_local executor_worker worker = { 0, 0 };
+		return worker;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// Handle for the result of a submitted task, move-only.
+// get() waits for the task and returns its result (moved out, so call it once),
+// rethrows the exception the delegate threw or throws task_cancelled.
+template<class R>
+class task_future
+{
+public:
+	task_future() : m_State(0) { }
+	explicit task_future(detail::task_state<R> *state) : m_State(state) { }
+	task_future(task_future &&x) : m_State(x.m_State) { x.m_State = 0; }
+	~task_future() { if(m_State) m_State->release(); }
+
+	task_future& operator = (task_future &&x)
+	{
+		if(this != &x)
+		{
+			if(m_State) m_State->release();
+			m_State = x.m_State;
+			x.m_State = 0;
+		}
+		return *this;
+	}
+
+	bool valid() const { return m_State != 0; }
+	bool ready() const { return m_State->finished(); }
+	bool cancelled() const { return m_State->status() == detail::task_is_cancelled; }
+
+	// Cancels the task if no worker has started it yet
+	bool cancel() { return m_State->cancel(); }
+
+	void wait() const { m_State->wait(); }
+	R get() { return m_State->get(); }
+
+private:
+	task_future(const task_future &);
+	void operator = (const task_future &);
+
+	detail::task_state<R> *m_State;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+class delegate_executor
+{
+public:
+	// 0 threads means one per hardware thread
+	explicit delegate_executor(size_t threads = 0)
+		: m_Next(0), m_Queued(0), m_Unfinished(0), m_Sleeping(0), m_IdleWaiters(0), m_Stop(false)
+	{
+		if(threads == 0)
+			threads = std::thread::hardware_concurrency();
+		if(threads == 0)
+			threads = 1;
+
+		for(size_t i = 0; i != threads; ++i)
+			m_Queues.push_back(std::unique_ptr<worker_queue>(new worker_queue));
+		for(size_t i = 0; i != threads; ++i)
+			m_Threads.push_back(std::thread(&delegate_executor::worker, this, i));
+	}
+
+	~delegate_executor()
+	{
+		{
+			std::lock_guard<std::mutex> l(m_WakeLock);
+			m_Stop.store(true);
+			m_Wake.notify_all();
+		}
+		for(size_t i = 0; i != m_Threads.size(); ++i)
+			m_Threads[i].join();
+	}
+
+	size_t size() const { return m_Threads.size(); }
+
+	// Queues the call d(args...), the arguments are copied into the task
+	template<class R, class... Params, class... Args>
+	task_future<R> submit(const delegate< R (Params...) > &d, Args&&... args)
+	{
+		static_assert(sizeof...(Args) == sizeof...(Params), "Wrong number of arguments for the delegate");
+		typedef detail::task_call<R, R (Params...), typename detail::make_index_list<sizeof...(Params)>::type, typename std::decay<Args>::type...> task_type;
+
+		task_type *task = new task_type(d, std::forward<Args>(args)...);
+		submit_task(task);
+		return task_future<R>(task);
+	}
+
+	// Queues a task node created by the caller, the queue holds one reference
+	void submit_task(detail::task_node *task)
+	{
+		m_Unfinished.fetch_add(1);
+		push(task);
+	}
+
+	// Waits until all submitted tasks have finished
+	void wait_idle()
+	{
+		std::unique_lock<std::mutex> l(m_WakeLock);
+		m_IdleWaiters.fetch_add(1);
+		while(m_Unfinished.load() != 0)
+			m_Idle.wait(l);
+		m_IdleWaiters.fetch_sub(1);
+	}
+
+private:
+	delegate_executor(const delegate_executor &);
+	void operator = (const delegate_executor &);
+
+	struct worker_queue
+	{
+		worker_queue() : inbox(0) { }
+
+		detail::task_deque tasks;
+		// Tasks from outside the pool, newest first
+		std::atomic<detail::task_node*> inbox;
+		char padding[CACHE_LINE_SIZE];
+	};
+
+	void push(detail::task_node *task)
+	{
+		detail::executor_worker &self = detail::current_executor_worker();
+		if(self.owner == this)
+			m_Queues[self.index]->tasks.push(task);
+		else
+		{
+			std::atomic<detail::task_node*> &inbox = m_Queues[m_Next.fetch_add(1, std::memory_order_relaxed) % m_Queues.size()]->inbox;
+			task->m_NextQueued = inbox.load(std::memory_order_relaxed);
+			while(!inbox.compare_exchange_weak(task->m_NextQueued, task, std::memory_order_release, std::memory_order_relaxed))
+				;
+		}
+
+		m_Queued.fetch_add(1);
+		if(m_Sleeping.load() != 0)
+		{
+			std::lock_guard<std::mutex> l(m_WakeLock);
+			m_Wake.notify_one();
+		}
+	}
+
+	// Own deque, then the inboxes starting with the own one, then the
+	// others' deques. 0 doesn't mean nothing is queued, a thief may have
+	// lost a race.
+	detail::task_node* take(size_t index)
+	{
+		detail::task_deque &own = m_Queues[index]->tasks;
+		detail::task_node *task = own.pop();
+		for(size_t i = 0; !task && i != m_Queues.size(); ++i)
+		{
+			// The inbox is newest first, so the oldest ends up at the bottom
+			detail::task_node *list = m_Queues[(index + i) % m_Queues.size()]->inbox.exchange(0, std::memory_order_acquire);
+			if(!list)
+				continue;
+			while(list)
+			{
+				// Once pushed it may be stolen and done with
+				detail::task_node *next = list->m_NextQueued;
+				own.push(list);
+				list = next;
+			}
+			task = own.pop();
+		}
+		for(size_t i = 1; !task && i != m_Queues.size(); ++i)
+			task = m_Queues[(index + i) % m_Queues.size()]->tasks.steal();
+
+		if(task)
+			m_Queued.fetch_sub(1);
+		return task;
+	}
+
+	void worker(size_t index)
+	{
+		detail::executor_worker &self = detail::current_executor_worker();
+		self.owner = this;
+		self.index = index;
+
+		for(;;)
+		{
+			if(detail::task_node *task = take(index))
+			{
+				task->run();
+				task->release();
+				if(m_Unfinished.fetch_sub(1) == 1 && m_IdleWaiters.load() != 0)
+				{
+					std::lock_guard<std::mutex> l(m_WakeLock);
+					m_Idle.notify_all();
+				}
+				continue;
+			}
+
+			std::unique_lock<std::mutex> l(m_WakeLock);
+			m_Sleeping.fetch_add(1);
+			while(m_Queued.load() == 0 && !m_Stop.load())
+				m_Wake.wait(l);
+			m_Sleeping.fetch_sub(1);
+			if(m_Queued.load() == 0 && m_Stop.load())
+				break;
+		}
+
+		self.owner = 0;
+	}
+
+	std::vector< std::unique_ptr<worker_queue> > m_Queues;
+	std::vector<std::thread> m_Threads;
+	std::atomic<size_t> m_Next;
+	std::atomic<long> m_Queued;
+	std::atomic<long> m_Unfinished;
+	std::atomic<int> m_Sleeping;
+	std::atomic<int> m_IdleWaiters;
+	std::atomic<bool> m_Stop;
+	std::mutex m_WakeLock;
+	std::condition_variable m_Wake;
+	std::condition_variable m_Idle;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+}
+
+#endif //_SF_DELEGATE_EXECUTOR_H__
@@ -0,0 +1,328 @@
+#ifndef _SF_DELEGATE_FLAT_MAP_H__
+#define _SF_DELEGATE_FLAT_MAP_H__
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "delegate.h"
+
+namespace delegates
+{
+
+//////////////////////////////////////////////////////////////////////////
+// Hashed containers keyed by delegates
+//////////////////////////////////////////////////////////////////////////
+
+// delegate_hash_map<> and delegate_hash_set<> are open-addressing hash tables
+// for delegate keys, meant for dispatch tables and "is this handler already
+// registered" checks on subscription paths:
+//
+//		delegate_hash_set< delegate<void (int)> > handlers;
+//		if(handlers.insert(make_delegate(&obj, &Obj::OnValue)))
+//			...
+//
+//		delegate_hash_map< delegate<void (int)>, int > priorities;
+//		priorities[make_delegate(&F1)] = 10;
+//		if(const int *p = priorities.find(make_delegate(&F1)))
+//			...
+//
+// Entries are stored in one array together with their hash value, lookups are
+// linear probes which compare the cached hash before the key, so a miss rarely
+// touches a key at all. The capacity is a power of two and the table grows
+// when it gets 3/4 full. Erasing shifts the following entries back instead of
+// leaving tombstones, so lookups don't slow down after many erases.
+//
+// Keys are hashed with std::hash<> (see function_data::GetHash()) and compared
+// with ==, which works for delegate<>, delegate_dynamic<> and delegate_any.
+// Inserting or erasing invalidates pointers returned by find().
+
+namespace detail
+{
+	struct flat_no_value { };
+
+	template<class Key, class Value, class Hash, class KeyEqual>
+	class flat_table
+	{
+	public:
+		typedef std::pair<Key, Value> value_type;
+
+		flat_table() : m_Slots(0), m_Mask(size_t(-1)), m_Size(0) { }
+
+		flat_table(const flat_table &x) : m_Slots(0), m_Mask(size_t(-1)), m_Size(0)
+		{
+			reserve(x.m_Size);
+			x.for_each_entry([this](const value_type &v) { insert_new(hash_of(v.first), v.first, v.second); });
+		}
+
+		flat_table& operator = (const flat_table &x)
+		{
+			if(this != &x)
+			{
+				flat_table tmp(x);
+				swap(tmp);
+			}
+			return *this;
+		}
+
+		flat_table(flat_table &&x) : m_Slots(x.m_Slots), m_Mask(x.m_Mask), m_Size(x.m_Size)
+		{
+			x.m_Slots = 0; x.m_Mask = size_t(-1); x.m_Size = 0;
+		}
+
+		flat_table& operator = (flat_table &&x)
+		{
+			flat_table tmp(std::move(x));
+			swap(tmp);
+			return *this;
+		}
+
+		~flat_table()
+		{
+			clear();
+			::operator delete(m_Slots);
+		}
+
+		void swap(flat_table &x)
+		{
+			std::swap(m_Slots, x.m_Slots);
+			std::swap(m_Mask, x.m_Mask);
+			std::swap(m_Size, x.m_Size);
+		}
+
+		size_t size() const { return m_Size; }
+		bool empty() const { return m_Size == 0; }
+		size_t capacity() const { return m_Mask + 1; }
+
+		void clear()
+		{
+			for(size_t i = 0; i != capacity(); ++i)
+				if(m_Slots[i].hash)
+					m_Slots[i].destroy();
+			m_Size = 0;
+		}
+
+		// Makes room for n entries without rehashing
+		void reserve(size_t n)
+		{
+			size_t cap = 8;
+			while(cap - cap / 4 < n)
+				cap *= 2;
+			if(cap > capacity())
+				rehash(cap);
+		}
+
+		value_type* find(const Key &k) const
+		{
+			if(m_Size == 0)
+				return 0;
+			size_t h = hash_of(k);
+			for(size_t i = h & m_Mask; m_Slots[i].hash; i = (i + 1) & m_Mask)
+				if(m_Slots[i].hash == h && KeyEqual()(m_Slots[i].value()->first, k))
+					return m_Slots[i].value();
+			return 0;
+		}
+
+		// Returns the entry for the key and true if it was added
+		template<class K, class... V>
+		std::pair<value_type*, bool> emplace(K &&k, V&&... v)
+		{
+			size_t h = hash_of(k);
+			if(m_Size != 0)
+			{
+				for(size_t i = h & m_Mask; m_Slots[i].hash; i = (i + 1) & m_Mask)
+					if(m_Slots[i].hash == h && KeyEqual()(m_Slots[i].value()->first, k))
+						return std::make_pair(m_Slots[i].value(), false);
+			}
+			reserve(m_Size + 1);
+			return std::make_pair(insert_new(h, std::forward<K>(k), std::forward<V>(v)...), true);
+		}
+
+		bool erase(const Key &k)
+		{
+			if(m_Size == 0)
+				return false;
+			size_t h = hash_of(k);
+			size_t i = h & m_Mask;
+			for(; ; i = (i + 1) & m_Mask)
+			{
+				if(!m_Slots[i].hash)
+					return false;
+				if(m_Slots[i].hash == h && KeyEqual()(m_Slots[i].value()->first, k))
+					break;
+			}
+			m_Slots[i].destroy();
+			--m_Size;
+
+			// Backward shift: move up every following entry of the probe
+			// sequence which may live at the freed position
+			for(size_t j = (i + 1) & m_Mask; m_Slots[j].hash; j = (j + 1) & m_Mask)
+			{
+				size_t home = m_Slots[j].hash & m_Mask;
+				if(((j - home) & m_Mask) >= ((j - i) & m_Mask))
+				{
+					m_Slots[i].construct(m_Slots[j].hash, std::move(*m_Slots[j].value()));
+					m_Slots[j].destroy();
+					i = j;
+				}
+			}
+			return true;
+		}
+
+		template<class F>
+		void for_each_entry(F f) const
+		{
+			for(size_t i = 0; i != capacity(); ++i)
+				if(m_Slots[i].hash)
+					f(*m_Slots[i].value());
+		}
+
+	private:
+		struct slot
+		{
+			size_t hash;	// 0 for free slots
+			typename std::aligned_storage<sizeof(value_type), std::alignment_of<value_type>::value>::type storage;
+
+			value_type* value() const { return reinterpret_cast<value_type*>(const_cast<slot*>(this)->storage_ptr()); }
+
+			template<class... A>
+			void construct(size_t h, A&&... a)
+			{
+				new (&storage) value_type(std::forward<A>(a)...);
+				hash = h;
+			}
+
+			void* storage_ptr() { return &storage; }
+
+			void destroy()
+			{
+				value()->~value_type();
+				hash = 0;
+			}
+		};
+
+		// The top bit is set so that no key hashes to 0, which marks free slots.
+		// Slot indices come from the low bits, which are left alone.
+		static size_t hash_of(const Key &k) { return Hash()(k) | ~(size_t(-1) >> 1); }
+
+		template<class K, class... V>
+		value_type* insert_new(size_t h, K &&k, V&&... v)
+		{
+			size_t i = h & m_Mask;
+			while(m_Slots[i].hash)
+				i = (i + 1) & m_Mask;
+			m_Slots[i].construct(h, std::piecewise_construct,
+				std::forward_as_tuple(std::forward<K>(k)), std::forward_as_tuple(std::forward<V>(v)...));
+			++m_Size;
+			return m_Slots[i].value();
+		}
+
+		void rehash(size_t cap)
+		{
+			slot *old = m_Slots;
+			size_t old_cap = capacity();
+
+			m_Slots = static_cast<slot*>(::operator new(cap * sizeof(slot)));
+			for(size_t i = 0; i != cap; ++i)
+				m_Slots[i].hash = 0;
+			m_Mask = cap - 1;
+
+			for(size_t i = 0; i != old_cap; ++i)
+			{
+				if(!old[i].hash)
+					continue;
+				size_t j = old[i].hash & m_Mask;
+				while(m_Slots[j].hash)
+					j = (j + 1) & m_Mask;
+				m_Slots[j].construct(old[i].hash, std::move(*old[i].value()));
+				old[i].destroy();
+			}
+			::operator delete(old);
+		}
+
+		slot *m_Slots;
+		size_t m_Mask;
+		size_t m_Size;
+	};
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+template<class Delegate, class Value, class Hash = std::hash<Delegate>, class KeyEqual = std::equal_to<Delegate> >
+class delegate_hash_map
+{
+	typedef detail::flat_table<Delegate, Value, Hash, KeyEqual> table_type;
+
+public:
+	typedef Delegate key_type;
+	typedef Value mapped_type;
+	typedef typename table_type::value_type value_type;
+
+	size_t size() const { return m_Table.size(); }
+	bool empty() const { return m_Table.empty(); }
+	void clear() { m_Table.clear(); }
+	void reserve(size_t n) { m_Table.reserve(n); }
+
+	// Returns null if the delegate isn't in the map
+	Value* find(const Delegate &d) { value_type *v = m_Table.find(d); return v ? &v->second : 0; }
+	const Value* find(const Delegate &d) const { value_type *v = m_Table.find(d); return v ? &v->second : 0; }
+
+	bool contains(const Delegate &d) const { return m_Table.find(d) != 0; }
+
+	// Default-constructs the value if the delegate isn't in the map yet
+	Value& operator[] (const Delegate &d) { return m_Table.emplace(d).first->second; }
+
+	// Returns false and leaves the stored value alone if the delegate is already in the map
+	template<class V>
+	bool insert(const Delegate &d, V &&v) { return m_Table.emplace(d, std::forward<V>(v)).second; }
+
+	// Returns false if the delegate wasn't in the map
+	bool erase(const Delegate &d) { return m_Table.erase(d); }
+
+	// Calls f(key, value) for every entry, in no particular order
+	template<class F>
+	void for_each(F f) const { m_Table.for_each_entry([&f](const value_type &v) { f(v.first, v.second); }); }
+
+private:
+	table_type m_Table;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+template<class Delegate, class Hash = std::hash<Delegate>, class KeyEqual = std::equal_to<Delegate> >
+class delegate_hash_set
+{
+	typedef detail::flat_table<Delegate, detail::flat_no_value, Hash, KeyEqual> table_type;
+
+public:
+	typedef Delegate key_type;
+	typedef Delegate value_type;
+
+	size_t size() const { return m_Table.size(); }
+	bool empty() const { return m_Table.empty(); }
+	void clear() { m_Table.clear(); }
+	void reserve(size_t n) { m_Table.reserve(n); }
+
+	bool contains(const Delegate &d) const { return m_Table.find(d) != 0; }
+
+	// Returns false if the delegate was already in the set
+	bool insert(const Delegate &d) { return m_Table.emplace(d).second; }
+
+	// Returns false if the delegate wasn't in the set
+	bool erase(const Delegate &d) { return m_Table.erase(d); }
+
+	// Calls f(key) for every delegate in the set, in no particular order
+	template<class F>
+	void for_each(F f) const { m_Table.for_each_entry([&f](const typename table_type::value_type &v) { f(v.first); }); }
+
+private:
+	table_type m_Table;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+}
+
+#endif //_SF_DELEGATE_FLAT_MAP_H__
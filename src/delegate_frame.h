@@ -0,0 +1,175 @@
+#ifndef _DELEGATE_FRAME_H__
+#define _DELEGATE_FRAME_H__
+
+#include "typetraits.h"
+
+//////////////////////////////////////////////////////////////////////////
+// Argument frames
+//////////////////////////////////////////////////////////////////////////
+
+// A frame is one contiguous buffer holding all arguments of a call, laid
+// out as a struct of the parameters would be: every argument at the next
+// offset suitable for its alignment. Reference parameters hold the referred
+// object, pointer parameters hold the pointer value (the same objects
+// invoke() expects behind args[N]).
+//
+// A deserializer can construct arguments directly at frame_layout<>::at<N>()
+// and call delegate_dynamic_base::invoke_frame(), without an array of
+// pointers and without copying the arguments out of the buffer.
+
+namespace detail
+{
+	template<size_t Offset, class... Params>
+	struct frame_slots
+	{
+		static const size_t end = Offset;
+		static const size_t align = 1;
+	};
+
+	template<size_t Offset, class T, class... Params>
+	struct frame_slots<Offset, T, Params...>
+	{
+		typedef typename t_strip<T>::noref type;
+		static const size_t offset = (Offset + std::alignment_of<type>::value - 1) / std::alignment_of<type>::value * std::alignment_of<type>::value;
+
+		typedef frame_slots<offset + sizeof(type), Params...> next;
+		static const size_t end = next::end;
+		static const size_t align = std::alignment_of<type>::value > next::align ? std::alignment_of<type>::value : next::align;
+	};
+
+	template<size_t N, class Slots>
+	struct frame_slot : frame_slot<N - 1, typename Slots::next> { };
+
+	template<class Slots>
+	struct frame_slot<0, Slots> : Slots { };
+}
+
+template <typename Signature> struct frame_layout;
+
+template<class R, class... Params>
+struct frame_layout< R (Params...) >
+{
+private:
+	typedef detail::frame_slots<0, Params...> slots;
+
+	template<size_t... I>
+	static void destroy_each(void *frame, detail::index_list<I...>)
+	{
+		int expand[] = { 0, (destroy_arg<I>(frame), 0)... };
+		(void)expand;
+	}
+
+	// Arguments are constructed in order. If one throws, those already built
+	// are destroyed in reverse order.
+	template<size_t... I, class... Args>
+	static void construct_each(void *frame, detail::index_list<I...>, Args&&... args)
+	{
+		size_t built = 0;
+		try
+		{
+			int expand[] = { 0, (construct<I>(frame, std::forward<Args>(args)), ++built, 0)... };
+			(void)expand;
+		}
+		catch(...)
+		{
+			void (*destroy[])(void *frame) = { 0, &destroy_arg<I>... };
+			for(; built != 0; --built)
+				destroy[built](frame);
+			throw;
+		}
+	}
+
+	template<size_t N>
+	static void destroy_arg(void *frame)
+	{
+		typedef typename std::remove_cv<typename arg<N>::type>::type plain;
+		const_cast<plain*>(at<N>(frame))->~plain();
+	}
+
+public:
+	static const size_t arity = sizeof...(Params);
+	// Size of the frame, a multiple of its alignment
+	static const size_t size = (slots::end + slots::align - 1) / slots::align * slots::align;
+	static const size_t align = slots::align;
+
+	// Type and offset of argument N
+	template<size_t N>
+	struct arg
+	{
+		typedef typename detail::frame_slot<N, slots>::type type;
+		static const size_t offset = detail::frame_slot<N, slots>::offset;
+	};
+
+	template<size_t N>
+	static typename arg<N>::type* at(void *frame)
+	{
+		return reinterpret_cast<typename arg<N>::type*>(static_cast<char*>(frame) + arg<N>::offset);
+	}
+
+	// Constructs argument N in place
+	template<size_t N, class... Args>
+	static void construct(void *frame, Args&&... args)
+	{
+		typedef typename std::remove_cv<typename arg<N>::type>::type plain;
+		new (const_cast<plain*>(at<N>(frame))) plain(std::forward<Args>(args)...);
+	}
+
+	// Constructs all arguments in place, from one value each
+	template<class... Args>
+	static void construct_all(void *frame, Args&&... args)
+	{
+		static_assert(sizeof...(Args) == sizeof...(Params), "Wrong number of arguments for the frame");
+		construct_each(frame, typename detail::make_index_list<sizeof...(Params)>::type(), std::forward<Args>(args)...);
+	}
+
+	static void destroy_all(void *frame)
+	{
+		destroy_each(frame, typename detail::make_index_list<sizeof...(Params)>::type());
+	}
+};
+
+template<class R, class... Params>
+const size_t frame_layout< R (Params...) >::arity;
+template<class R, class... Params>
+const size_t frame_layout< R (Params...) >::size;
+template<class R, class... Params>
+const size_t frame_layout< R (Params...) >::align;
+template<class R, class... Params>
+template<size_t N>
+const size_t frame_layout< R (Params...) >::arg<N>::offset;
+
+//////////////////////////////////////////////////////////////////////////
+
+// arg_frame<> is a frame with its own storage. All arguments are constructed
+// on creation and destroyed with the frame:
+//
+//		arg_frame< int (const std::string&, double) > f(name, 2.0);
+//		dyn.invoke_frame(f.data(), &ret);
+template <typename Signature> class arg_frame;
+
+template<class R, class... Params>
+class arg_frame< R (Params...) >
+{
+public:
+	typedef frame_layout< R (Params...) > layout;
+
+	template<class... Args>
+	explicit arg_frame(Args&&... args) { layout::construct_all(data(), std::forward<Args>(args)...); }
+	~arg_frame() { layout::destroy_all(data()); }
+
+	void* data() { return &m_Storage; }
+	const void* data() const { return &m_Storage; }
+
+	template<size_t N>
+	typename layout::template arg<N>::type& get() { return *layout::template at<N>(data()); }
+
+private:
+	arg_frame(const arg_frame &);
+	void operator = (const arg_frame &);
+
+	typename std::aligned_storage<layout::size ? layout::size : 1, layout::align>::type m_Storage;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+#endif //_DELEGATE_FRAME_H__
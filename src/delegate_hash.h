@@ -0,0 +1,24 @@
+#ifndef _DELEGATE_HASH_H__
+#define _DELEGATE_HASH_H__
+
+//////////////////////////////////////////////////////////////////////////
+// std::hash for closure data and delegates, included by the public headers
+// outside of namespace delegates
+//////////////////////////////////////////////////////////////////////////
+
+namespace std
+{
+	template<>
+	struct hash<delegates::detail::function_data>
+	{
+		size_t operator()(const delegates::detail::function_data &x) const { return x.GetHash(); }
+	};
+
+	template<class Signature>
+	struct hash< delegates::delegate<Signature> >
+	{
+		size_t operator()(const delegates::delegate<Signature> &x) const { return x.getFunctionData().GetHash(); }
+	};
+}
+
+#endif //_DELEGATE_HASH_H__
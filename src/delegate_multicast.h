@@ -0,0 +1,213 @@
+#ifndef _SF_DELEGATE_MULTICAST_H__
+#define _SF_DELEGATE_MULTICAST_H__
+
+#include <vector>
+#include "delegate.h"
+#include "delegate_weak.h"
+
+// Prefetch hint used while firing to pull the next target object into cache
+#if defined(__GNUC__)
+#	define FASTDELEGATE_PREFETCH(addr) __builtin_prefetch(addr)
+#elif defined(FASTDLGT_ISMSVC) && (defined(_M_IX86) || defined(_M_X64))
+#	include <xmmintrin.h>
+#	define FASTDELEGATE_PREFETCH(addr) _mm_prefetch(reinterpret_cast<const char*>(addr), _MM_HINT_T0)
+#else
+#	define FASTDELEGATE_PREFETCH(addr)
+#endif
+
+namespace delegates
+{
+
+//////////////////////////////////////////////////////////////////////////
+// Multicast delegates
+//////////////////////////////////////////////////////////////////////////
+
+// multicast_delegate<> keeps the closures of all subscribers in one contiguous
+// array of (m_pthis, m_pFunction) pairs, so firing is a single linear pass
+// without copying any delegate objects. While one target is being called
+// the object of the next one is prefetched.
+//
+// Subscribing is amortized O(1). Unsubscribing is a linear search which
+// preserves the firing order. The subscriber list must not be modified
+// from inside a handler. Return values of handlers are discarded.
+//
+// Weak subscribers (weak_delegate<>) are skipped once their target is gone
+// and removed on the next add(), remove() or purge(). Their liveness checks
+// live in a second array which stays empty until the first weak subscriber,
+// so lists without them fire exactly as before.
+//
+//		multicast_delegate< void (int) > ev;
+//		ev += &F1;
+//		ev += make_delegate(&obj, &Obj::OnValue);
+//		ev(10);
+
+template <typename Signature>
+class multicast_delegate
+{
+public:
+	typedef delegate<Signature> delegate_type;
+	typedef multicast_delegate this_type;
+
+	multicast_delegate() { }
+	multicast_delegate(const multicast_delegate &x) : m_Closures(x.m_Closures), m_Guards(x.m_Guards) { rebase(); }
+	void operator = (const multicast_delegate &x) { m_Closures = x.m_Closures; m_Guards = x.m_Guards; rebase(); }
+
+	// Subscription
+	void add(const delegate_type &d)
+	{
+		if(d.empty())
+			return;
+
+		purge();
+		if(!m_Guards.empty())
+			m_Guards.push_back(weak_ref());
+		push(d);
+	}
+
+	// Weak subscription, dropped once the target is destroyed
+	void add(const weak_delegate<Signature> &d)
+	{
+		if(!d.alive())
+			return;
+
+		purge();
+		m_Guards.resize(m_Closures.size());
+		m_Guards.push_back(d.ref());
+		push(d.get());
+	}
+
+	// Removes first subscription equal to the delegate, returns false if there is none
+	bool remove(const delegate_type &d)
+	{
+		for(size_t i = 0; i != m_Closures.size(); ++i)
+		{
+			if(m_Closures[i].IsEqual(d.getFunctionData()))
+			{
+				m_Closures.erase(m_Closures.begin() + i);
+				if(!m_Guards.empty())
+					m_Guards.erase(m_Guards.begin() + i);
+				rebase();
+				purge();
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool contains(const delegate_type &d) const
+	{
+		for(size_t i = 0; i != m_Closures.size(); ++i)
+			if(m_Closures[i].IsEqual(d.getFunctionData()))
+				return true;
+		return false;
+	}
+
+	bool remove(const weak_delegate<Signature> &d) { return remove(d.get()); }
+
+	void operator += (const delegate_type &d) { add(d); }
+	void operator -= (const delegate_type &d) { remove(d); }
+	void operator += (const weak_delegate<Signature> &d) { add(d); }
+	void operator -= (const weak_delegate<Signature> &d) { remove(d); }
+
+	// Removes weak subscribers whose targets are gone, returns their number
+	size_t purge()
+	{
+		if(m_Guards.empty())
+			return 0;
+
+		size_t kept = 0, weak = 0;
+		for(size_t i = 0; i != m_Closures.size(); ++i)
+		{
+			if(m_Guards[i].expired())
+				continue;
+			weak += m_Guards[i].alive();
+			m_Closures[kept] = m_Closures[i];
+			m_Guards[kept] = m_Guards[i];
+			++kept;
+		}
+		size_t removed = m_Closures.size() - kept;
+		m_Closures.resize(kept);
+		if(weak)
+			m_Guards.resize(kept);
+		else
+			m_Guards.clear();
+		if(removed)
+			rebase();
+		return removed;
+	}
+
+	void reserve(size_t n) { m_Closures.reserve(n); rebase(); }
+	void clear() { m_Closures.clear(); m_Guards.clear(); }
+	size_t size() const { return m_Closures.size(); }
+	bool empty() const { return m_Closures.empty(); }
+
+	// Invoke all subscribers in order of subscription.
+	// Arguments are passed to every handler as lvalues, so rvalues can't be
+	// moved away by the first subscriber.
+	template<class... Pf>
+	void operator() (Pf&&... params) const
+	{
+		const ClosureType *it = m_Closures.empty() ? 0 : &m_Closures[0];
+		const ClosureType *last = it + m_Closures.size();
+		if(!m_Guards.empty())
+		{
+			const weak_ref *guard = &m_Guards[0];
+			for(; it != last; ++it, ++guard)
+			{
+				if(guard->expired())
+					continue;
+				FASTDLGT_TIME_CALLS(*it, 1);
+				(it->GetClosureThis()->*(it->GetClosureMemPtr()))(params...);
+			}
+			return;
+		}
+		for(; it != last; ++it)
+		{
+			if(it + 1 != last)
+				FASTDELEGATE_PREFETCH((it + 1)->GetClosureThis());
+			FASTDLGT_TIME_CALLS(*it, 1);
+			(it->GetClosureThis()->*(it->GetClosureMemPtr()))(params...);
+		}
+	}
+
+private:
+	typedef typename delegate_type::closure_type ClosureType;
+
+	// Safe version of closure_ptr keeps static functions as self-references,
+	// they have to be restored every time the array is reallocated or shifted.
+	void push(const delegate_type &d)
+	{
+		size_t cap = m_Closures.capacity();
+		m_Closures.push_back(ClosureType());
+		m_Closures.back().CopyFrom(&m_Closures.back(), d.getFunctionData());
+
+		if(cap != m_Closures.capacity())
+			rebase();
+	}
+
+	void rebase()
+	{
+#if !defined(FASTDELEGATE_USESTATICFUNCTIONHACK)
+		for(size_t i = 0; i != m_Closures.size(); ++i)
+			m_Closures[i].CopyFrom(&m_Closures[i], m_Closures[i]);
+#endif
+	}
+
+	std::vector<ClosureType> m_Closures;
+	std::vector<weak_ref> m_Guards;		// empty without weak subscribers, else one per closure
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+// Same as multicast_delegate, reads better for event members:
+//		event< void (const Message&) > MessageReceived;
+template <typename Signature>
+class event : public multicast_delegate<Signature>
+{
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+}
+
+#endif //_SF_DELEGATE_MULTICAST_H__
@@ -0,0 +1,207 @@
+#ifndef _SF_DELEGATE_OWNING_H__
+#define _SF_DELEGATE_OWNING_H__
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "delegate.h"
+
+namespace delegates
+{
+
+//////////////////////////////////////////////////////////////////////////
+// Owning delegates
+//////////////////////////////////////////////////////////////////////////
+
+// owning_delegate<> stores an arbitrary callable object (lambda, functor)
+// together with the closure that calls it, so it can be kept around after
+// the callable goes out of scope:
+//
+//		owning_delegate< void (int) > d = [this, name](int v) { ... };
+//		d(10);
+//
+// Callables up to BufferSize bytes which can be moved without throwing are
+// stored inside the delegate itself, bigger ones are allocated on the heap.
+// Move-only callables are supported, owning_delegate itself is move-only.
+//
+// The callable is wrapped in a holder whose member function is bound into
+// the ordinary closure_ptr, so invoking is the same single member function
+// pointer call as for delegate<>. Plain functions and object/method pairs
+// are stored without a holder.
+
+template <typename Signature, size_t BufferSize = 32> class owning_delegate;
+
+template<class R, class... Params, size_t BufferSize>
+class owning_delegate< R (Params...), BufferSize > : private delegate< R (Params...) >
+{
+	typedef delegate< R (Params...) > base;
+
+	typedef typename std::aligned_storage<BufferSize, std::alignment_of<std::max_align_t>::value>::type storage_type;
+
+	template<class F>
+	struct is_functor
+	{
+		typedef typename std::decay<F>::type plain;
+		static const bool value = std::is_class<plain>::value
+			&& !std::is_same<plain, owning_delegate>::value
+			&& !std::is_base_of<base, plain>::value;
+	};
+
+	// The object whose method gets bound into the closure.
+	// Parameters are received as the static function invoker does it,
+	// so the holder doesn't add copies (see detail::static_param).
+	template<class F>
+	struct holder
+	{
+		F functor;
+
+		template<class Fw>
+		explicit holder(Fw &&f) : functor(std::forward<Fw>(f)) { }
+
+		R call(typename detail::static_param<Params>::type... params)
+		{
+			return detail::functor_call<R>::call(functor, std::forward<Params>(params)...);
+		}
+	};
+
+public:
+	typedef delegate< R (Params...) > delegate_type;
+	typedef owning_delegate this_type;
+	typedef R result_type;
+
+	// Does the callable of type F get stored without heap allocation?
+	template<class F>
+	struct fits_inline
+	{
+		static const bool value = sizeof(holder<F>) <= BufferSize
+			&& std::alignment_of< holder<F> >::value <= std::alignment_of<storage_type>::value
+			&& std::is_nothrow_move_constructible<F>::value;
+	};
+
+	owning_delegate() : m_Manager(0) { }
+
+	owning_delegate(const delegate_type &d) : base(d), m_Manager(0) { }
+
+	owning_delegate(R (*function_to_bind)(Params... params)) : base(function_to_bind), m_Manager(0) { }
+
+	template < class X, class Y >
+	owning_delegate(Y *pthis, R (X::* function_to_bind)(Params... params))
+		: base(pthis, function_to_bind), m_Manager(0) { }
+
+	template < class X, class Y >
+	owning_delegate(const Y *pthis, R (X::* function_to_bind)(Params... params) const)
+		: base(pthis, function_to_bind), m_Manager(0) { }
+
+	// Takes ownership of a copy (or the moved value) of the callable
+	template<class F>
+	owning_delegate(F &&f, typename std::enable_if<is_functor<F>::value>::type* = 0)
+		: m_Manager(0)
+	{
+		bind_functor(std::forward<F>(f), std::integral_constant<bool, fits_inline<typename std::decay<F>::type>::value>());
+	}
+
+	owning_delegate(owning_delegate &&x) : m_Manager(0) { move_from(x); }
+
+	owning_delegate& operator = (owning_delegate &&x)
+	{
+		if(this != &x)
+		{
+			clear();
+			move_from(x);
+		}
+		return *this;
+	}
+
+	~owning_delegate() { destroy(); }
+
+	void clear() { destroy(); base::clear(); }
+
+	using base::operator();
+	using base::empty;
+	using base::operator!;
+	using base::getFunctionData;
+
+	explicit operator bool() const { return !base::empty(); }
+
+	// Does the delegate own a callable?
+	bool owns_callable() const { return m_Manager != 0; }
+
+private:
+	owning_delegate(const owning_delegate &);
+	void operator = (const owning_delegate &);
+
+	enum manager_op { op_move, op_destroy };
+	typedef void (*manager_fn)(manager_op op, owning_delegate &self, owning_delegate *from);
+
+	template<class F>
+	static void manage_inline(manager_op op, owning_delegate &self, owning_delegate *from)
+	{
+		if(op == op_move)
+		{
+			holder<F> *src = reinterpret_cast<holder<F>*>(&from->m_Storage);
+			holder<F> *dst = new (&self.m_Storage) holder<F>(std::move(src->functor));
+			src->~holder<F>();
+			self.m_Closure.bindmemfunc(dst, &holder<F>::call);
+		}
+		else
+		{
+			reinterpret_cast<holder<F>*>(&self.m_Storage)->~holder<F>();
+		}
+	}
+
+	template<class F>
+	static void manage_heap(manager_op op, owning_delegate &self, owning_delegate *from)
+	{
+		if(op == op_move)
+			self.m_Closure.CopyFrom(&self, from->m_Closure);
+		else
+			delete reinterpret_cast<holder<F>*>(self.m_Closure.GetClosureThis());
+	}
+
+	template<class F>
+	void bind_functor(F &&f, std::true_type /*inline*/)
+	{
+		typedef holder<typename std::decay<F>::type> holder_type;
+		holder_type *h = new (&m_Storage) holder_type(std::forward<F>(f));
+		this->m_Closure.bindmemfunc(h, &holder_type::call);
+		m_Manager = &manage_inline<typename std::decay<F>::type>;
+	}
+
+	template<class F>
+	void bind_functor(F &&f, std::false_type /*inline*/)
+	{
+		typedef holder<typename std::decay<F>::type> holder_type;
+		holder_type *h = new holder_type(std::forward<F>(f));
+		this->m_Closure.bindmemfunc(h, &holder_type::call);
+		m_Manager = &manage_heap<typename std::decay<F>::type>;
+	}
+
+	void move_from(owning_delegate &x)
+	{
+		if(x.m_Manager)
+			x.m_Manager(op_move, *this, &x);
+		else
+			base::operator=(x);
+
+		m_Manager = x.m_Manager;
+		x.m_Manager = 0;
+		x.base::clear();
+	}
+
+	void destroy()
+	{
+		if(m_Manager)
+			m_Manager(op_destroy, *this, 0);
+		m_Manager = 0;
+	}
+
+	manager_fn m_Manager;
+	storage_type m_Storage;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+}
+
+#endif //_SF_DELEGATE_OWNING_H__
@@ -0,0 +1,342 @@
+#ifndef _SF_DELEGATE_QUEUE_H__
+#define _SF_DELEGATE_QUEUE_H__
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "delegate.h"
+#include "delegate_dynamic.h"
+
+namespace delegates
+{
+
+//////////////////////////////////////////////////////////////////////////
+// Queued calls
+//////////////////////////////////////////////////////////////////////////
+
+// call_queue<> lets any number of threads post delegate calls which one
+// owning thread (UI, simulation tick) runs later:
+//
+//		call_queue<> q;
+//		q.post(make_delegate(&view, &View::SetProgress), 0.5f);	// worker threads
+//		q.drain();													// owning thread
+//
+// The queue is a bounded lock-free ring of fixed-size slots. A slot holds the
+// closure data, a pointer to a typed thunk and the arguments packed inline
+// (see frame_layout<>), so posting doesn't allocate. Arguments are copied or
+// moved into the slot and moved into the call, at most ArgCapacity bytes.
+// Reference parameters refer to the copy in the slot, pass pointers to
+// reach the caller's objects.
+//
+// Posting claims a slot with one CAS on the tail, the consumer needs no atomic
+// read-modify-write at all (per-slot sequence numbers, D. Vyukov's bounded queue).
+// What happens when the ring is full is set by queue_full_policy:
+//		queue_full_block	the producer waits until the consumer frees a slot
+//		queue_full_drop		post() returns false, the call is discarded
+//		queue_full_grow		the call goes to a heap-allocated overflow list
+// Calls of a single producer are always run in the order they were posted.
+
+enum queue_full_policy
+{
+	queue_full_block,
+	queue_full_drop,
+	queue_full_grow
+};
+
+namespace detail
+{
+	// Bound arguments are passed as lvalues to reference parameters and moved otherwise
+	template<class P, class T>
+	typename std::conditional<std::is_lvalue_reference<P>::value, T&, T&&>::type queued_arg(T &v)
+	{
+		return static_cast<typename std::conditional<std::is_lvalue_reference<P>::value, T&, T&&>::type>(v);
+	}
+
+	template<class R, class Indices, class... Params>
+	struct queued_call;
+
+	template<class R, size_t... I, class... Params>
+	struct queued_call<R, index_list<I...>, Params...>
+	{
+		typedef delegate< R (Params...) > deleg_type;
+		typedef frame_layout< void (typename std::decay<Params>::type...) > layout;
+
+		// Runs the call (unless 'run' is false) and destroys the arguments,
+		// also when the call throws
+		static void call(const function_data &fd, void *args, bool run)
+		{
+			struct destroyer
+			{
+				void *args;
+				~destroyer() { layout::destroy_all(args); }
+			} guard = { args };
+
+			if(run)
+			{
+				delegate_view<deleg_type> dlg(fd);
+				dlg.get()(queued_arg<Params>(*layout::template at<I>(args))...);
+			}
+		}
+	};
+}
+
+template<size_t ArgCapacity = 48>
+class call_queue
+{
+	typedef void (*invoker_type)(const detail::function_data &fd, void *args, bool run);
+
+	struct call_data
+	{
+		invoker_type invoker;
+		detail::function_data data;
+		typename std::aligned_storage<ArgCapacity ? ArgCapacity : 1, std::alignment_of<std::max_align_t>::value>::type args;
+	};
+
+	struct slot
+	{
+		std::atomic<size_t> sequence;
+		call_data call;
+	};
+
+public:
+	static const size_t arg_capacity = ArgCapacity;
+
+	// Capacity is rounded up to a power of two
+	explicit call_queue(size_t capacity = 1024, queue_full_policy policy = queue_full_block)
+		: m_Policy(policy), m_Head(0), m_Tail(0), m_OverflowCount(0)
+	{
+		size_t size = 2;
+		while(size < capacity)
+			size *= 2;
+		m_Mask = size - 1;
+		m_Slots = new slot[size];
+		for(size_t i = 0; i != size; ++i)
+			m_Slots[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	// Calls still queued are destroyed without running
+	~call_queue()
+	{
+		run_calls(size_t(-1), false);
+		delete [] m_Slots;
+	}
+
+	size_t capacity() const { return m_Mask + 1; }
+	queue_full_policy policy() const { return m_Policy; }
+
+	// Queues the call d(args...), can be called from any thread.
+	// Returns false if the call was dropped because the queue is full.
+	template<class R, class... Params, class... Args>
+	bool post(const delegate< R (Params...) > &d, Args&&... args)
+	{
+		static_assert(sizeof...(Args) == sizeof...(Params), "Wrong number of arguments for the delegate");
+		typedef detail::queued_call<R, typename detail::make_index_list<sizeof...(Params)>::type, Params...> call_type;
+		static_assert(call_type::layout::size <= ArgCapacity, "Arguments don't fit into the queue slot, increase ArgCapacity");
+		static_assert(call_type::layout::align <= std::alignment_of<std::max_align_t>::value, "Over-aligned arguments can't be queued");
+
+		slot *s = 0;
+		call_data *c = acquire(s);
+		if(!c)
+			return false;
+
+		c->data = d.getFunctionData();
+		try
+		{
+			call_type::layout::construct_all(&c->args, std::forward<Args>(args)...);
+		}
+		catch(...)
+		{
+			// The ring slot is claimed already, the consumer has to step over it
+			if(s)
+			{
+				c->invoker = &skip_call;
+				publish(c, s);
+			}
+			else
+				delete c;
+			throw;
+		}
+		c->invoker = &call_type::call;
+		publish(c, s);
+		return true;
+	}
+
+	// Runs up to max_calls queued calls on the calling thread, must only be
+	// called by one thread at a time. Returns the number of calls run.
+	size_t drain(size_t max_calls = size_t(-1)) { return run_calls(max_calls, true); }
+
+	// Approximate, exact only on the consumer thread with no producers running
+	bool empty() const
+	{
+		size_t head = m_Head.load(std::memory_order_relaxed);
+		return m_Slots[head & m_Mask].sequence.load(std::memory_order_acquire) != head + 1
+			&& m_OverflowCount.load() == 0;
+	}
+
+private:
+	call_queue(const call_queue &);
+	void operator = (const call_queue &);
+
+	// Takes the place of a call whose arguments failed to copy
+	static void skip_call(const detail::function_data &, void *, bool) { }
+
+	// Reserves the storage for the next call: a ring slot (returned in 's')
+	// or an overflow entry
+	call_data* acquire(slot *&s)
+	{
+		for(;;)
+		{
+			// Once calls went to the overflow list the following ones go there
+			// too, until the consumer caught up, to keep the order per producer
+			if(m_Policy == queue_full_grow && m_OverflowCount.load() != 0)
+			{
+				s = 0;
+				return new call_data;
+			}
+
+			size_t pos = m_Tail.load(std::memory_order_relaxed);
+			for(;;)
+			{
+				s = &m_Slots[pos & m_Mask];
+				size_t seq = s->sequence.load(std::memory_order_acquire);
+				ptrdiff_t diff = ptrdiff_t(seq) - ptrdiff_t(pos);
+				if(diff == 0)
+				{
+					if(m_Tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+						return &s->call;
+				}
+				else if(diff < 0)
+					break; // full
+				else
+					pos = m_Tail.load(std::memory_order_relaxed);
+			}
+
+			s = 0;
+			switch(m_Policy)
+			{
+			case queue_full_drop:
+				return 0;
+			case queue_full_grow:
+				return new call_data;
+			default:
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	void publish(call_data *c, slot *s)
+	{
+		if(!s)
+		{
+			std::lock_guard<std::mutex> l(m_OverflowLock);
+			m_Overflow.push_back(c);
+			m_OverflowCount.fetch_add(1);
+			return;
+		}
+
+		size_t pos = s->sequence.load(std::memory_order_relaxed);
+		s->sequence.store(pos + 1, std::memory_order_release);
+	}
+
+	// Hands the slot at the head back to the producers once its call is
+	// done, whether it returned or threw
+	struct slot_release
+	{
+		call_queue *queue;
+		slot *s;
+
+		~slot_release()
+		{
+			size_t head = queue->m_Head.load(std::memory_order_relaxed);
+			s->sequence.store(head + queue->m_Mask + 1, std::memory_order_release);
+			queue->m_Head.store(head + 1, std::memory_order_relaxed);
+		}
+	};
+
+	// Accounts for the overflow calls taken out of the list. The ones which
+	// didn't run (past max_calls or after one threw) are put back in front.
+	struct overflow_release
+	{
+		call_queue *queue;
+		std::vector<call_data*> &calls;
+		size_t taken;
+
+		~overflow_release()
+		{
+			if(taken != calls.size())
+			{
+				std::lock_guard<std::mutex> l(queue->m_OverflowLock);
+				queue->m_Overflow.insert(queue->m_Overflow.begin(), calls.begin() + taken, calls.end());
+			}
+			queue->m_OverflowCount.fetch_sub(taken);
+		}
+	};
+
+	size_t run_calls(size_t max_calls, bool run)
+	{
+		size_t done = 0;
+		while(done != max_calls)
+		{
+			size_t head = m_Head.load(std::memory_order_relaxed);
+			slot &s = m_Slots[head & m_Mask];
+			if(s.sequence.load(std::memory_order_acquire) != head + 1)
+				break;
+
+			slot_release release = { this, &s };
+			if(s.call.invoker == &skip_call)
+				continue;
+			s.call.invoker(s.call.data, &s.call.args, run);
+			++done;
+		}
+
+		if(done != max_calls && m_OverflowCount.load() != 0)
+		{
+			// Overflow calls come after everything claimed in the ring, a
+			// slot may still be written by a producer which posted to the
+			// overflow list since. Checked under the lock, so a slot claimed
+			// before the last call went to the list is seen.
+			std::vector<call_data*> calls;
+			{
+				std::lock_guard<std::mutex> l(m_OverflowLock);
+				if(m_Tail.load(std::memory_order_relaxed) == m_Head.load(std::memory_order_relaxed))
+					calls.swap(m_Overflow);
+			}
+			// Calls beyond max_calls go back to the list
+			overflow_release release = { this, calls, 0 };
+			while(release.taken != calls.size() && done != max_calls)
+			{
+				std::unique_ptr<call_data> c(calls[release.taken++]);
+				c->invoker(c->data, &c->args, run);
+				++done;
+			}
+		}
+		return done;
+	}
+
+	slot *m_Slots;
+	size_t m_Mask;
+	queue_full_policy m_Policy;
+
+	// Consumer and producer ends on separate cache lines
+	char m_Padding0[CACHE_LINE_SIZE];
+	std::atomic<size_t> m_Head;	// written by the consumer only, atomic for empty()
+	char m_Padding1[CACHE_LINE_SIZE];
+	std::atomic<size_t> m_Tail;
+	char m_Padding2[CACHE_LINE_SIZE];
+
+	std::atomic<size_t> m_OverflowCount;
+	std::mutex m_OverflowLock;
+	std::vector<call_data*> m_Overflow;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+}
+
+#endif //_SF_DELEGATE_QUEUE_H__
@@ -0,0 +1,283 @@
+#ifndef _SF_DELEGATE_REGISTRY_H__
+#define _SF_DELEGATE_REGISTRY_H__
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "delegate_dynamic.h"
+
+namespace delegates
+{
+
+//////////////////////////////////////////////////////////////////////////
+// Method registries
+//////////////////////////////////////////////////////////////////////////
+
+// method_registry maps method names to delegate_dynamic_base handles, typically
+// one registry per reflected class:
+//
+//		method_registry methods;
+//		methods.add("SetName", &set_name);		// delegate_dynamic<> objects
+//		methods.add("GetSize", &get_size);
+//		methods.build();
+//
+//		delegate_dynamic_base *m = methods.find("SetName");
+//
+// build() computes a minimal perfect hash over the names (hash and displace:
+// names are grouped into buckets, every bucket gets a seed which sends all of
+// its names to free slots), so the entries occupy one contiguous table of
+// exactly size() slots. A lookup hashes the name once, reads the bucket seed
+// and compares the name of the single candidate slot. Nothing is allocated.
+//
+// A method_cache kept at the call site skips even the hashing after the first
+// lookup, it remembers the slot together with the build generation:
+//
+//		static method_cache cache;
+//		methods.invoke(cache, "SetName", args, 0);
+//
+// A cache must only be used with one name. Caches can be shared between
+// threads, find() and invoke() are safe to call concurrently, add() and build()
+// are not. The registry doesn't own the delegates.
+
+// Per call site lookup cache, see method_registry
+class method_cache
+{
+public:
+	method_cache() : m_State(0) { }
+
+private:
+	friend class method_registry;
+	method_cache(const method_cache &);
+	void operator = (const method_cache &);
+
+	// Build generation in the high half, slot + 1 in the low half, 0 when empty
+	std::atomic<unsigned long long> m_State;
+};
+
+namespace detail
+{
+	// Every build of any registry gets a new generation, so a cache can't
+	// mistake a slot of another registry (or an older table) for its own
+	inline unsigned next_registry_generation()
+	{
+		static std::atomic<unsigned> generation(0);
+		unsigned g;
+		while((g = ++generation) == 0)
+			;
+		return g;
+	}
+}
+
+class method_registry
+{
+public:
+	method_registry() : m_Salt(0), m_Generation(0) { }
+
+	// Registers a method, the entry is visible after the next build().
+	// Returns false if a method of that name is already registered.
+	bool add(const std::string &name, delegate_dynamic_base *method)
+	{
+		for(size_t i = 0; i != m_Pending.size(); ++i)
+			if(m_Pending[i].name == name)
+				return false;
+		pending_entry e = { name, method };
+		m_Pending.push_back(e);
+		return true;
+	}
+
+	// Builds the perfect hash table over all names added so far
+	// and invalidates the method_caches used with this registry
+	void build()
+	{
+		size_t n = m_Pending.size();
+		m_Entries.assign(n, entry());
+		m_Seeds.assign(n / 2 + 1, 0);
+		m_Names.clear();
+		for(size_t i = 0; i != n; ++i)
+			m_Names.append(m_Pending[i].name).push_back('\0');
+
+		std::vector<size_t> order(n);
+		for(m_Salt = 0; !place(order); ++m_Salt)
+			;
+
+		// Names are referenced in place, m_Names doesn't change from here on
+		const char *names = m_Names.c_str();
+		for(size_t i = 0; i != n; ++i)
+		{
+			entry &e = m_Entries[order[i]];
+			e.name = names;
+			e.length = m_Pending[i].name.size();
+			e.method = m_Pending[i].method;
+			names += e.length + 1;
+		}
+		m_Generation = detail::next_registry_generation();
+	}
+
+	// Number of methods in the built table
+	size_t size() const { return m_Entries.size(); }
+
+	// Returns null if there is no method of that name
+	delegate_dynamic_base* find(const char *name, size_t length) const
+	{
+		const entry *e = lookup(name, length);
+		return e ? e->method : 0;
+	}
+
+	delegate_dynamic_base* find(const char *name) const { return find(name, strlen(name)); }
+	delegate_dynamic_base* find(const std::string &name) const { return find(name.data(), name.size()); }
+
+	// Looks up through the call site cache
+	delegate_dynamic_base* find(method_cache &cache, const char *name) const
+	{
+		unsigned long long state = cache.m_State.load(std::memory_order_relaxed);
+		if((state >> 32) == m_Generation && m_Generation != 0)
+			return m_Entries[size_t(state & 0xffffffffu) - 1].method;
+
+		const entry *e = lookup(name, strlen(name));
+		if(!e)
+			return 0;
+		size_t slot = e - &m_Entries[0];
+		cache.m_State.store((static_cast<unsigned long long>(m_Generation) << 32) | (slot + 1), std::memory_order_relaxed);
+		return e->method;
+	}
+
+	// Calls the method of that name, returns false if there is none
+	bool invoke(method_cache &cache, const char *name, void **args, void *ret) const
+	{
+		delegate_dynamic_base *m = find(cache, name);
+		if(!m)
+			return false;
+		m->invoke(args, ret);
+		return true;
+	}
+
+	// Entries in table order
+	const char* name_at(size_t slot) const { return m_Entries[slot].name; }
+	delegate_dynamic_base* method_at(size_t slot) const { return m_Entries[slot].method; }
+
+private:
+	method_registry(const method_registry &);
+	void operator = (const method_registry &);
+
+	struct pending_entry
+	{
+		std::string name;
+		delegate_dynamic_base *method;
+	};
+
+	struct entry
+	{
+		const char *name;
+		size_t length;
+		delegate_dynamic_base *method;
+		entry() : name(0), length(0), method(0) { }
+	};
+
+	// Eight bytes of the name per multiply, finished by the closure hash mixer
+	static unsigned long long hash_name(const char *name, size_t length, unsigned salt)
+	{
+		unsigned long long h = (0xcbf29ce484222325ULL ^ salt) + length;
+		for(; length >= 8; name += 8, length -= 8)
+		{
+			unsigned long long word;
+			memcpy(&word, name, 8);
+			h = (h ^ word) * 0x9e3779b97f4a7c15ULL;
+			h ^= h >> 29;
+		}
+		if(length)
+		{
+			unsigned long long word = 0;
+			memcpy(&word, name, length);
+			h = (h ^ word) * 0x9e3779b97f4a7c15ULL;
+		}
+		return detail::hash_mix(h);
+	}
+
+	// Ranges are reduced with a multiply instead of a division: (32-bit hash * n) >> 32
+	size_t bucket_of(unsigned long long h) const { return size_t(((h >> 32) * m_Seeds.size()) >> 32); }
+
+	size_t slot_of(unsigned long long h, unsigned seed) const
+	{
+		unsigned long long x = (h ^ (seed * 0x9e3779b97f4a7c15ULL)) * 0xff51afd7ed558ccdULL;
+		return size_t(((x >> 32) * m_Entries.size()) >> 32);
+	}
+
+	const entry* lookup(const char *name, size_t length) const
+	{
+		if(m_Entries.empty())
+			return 0;
+		unsigned long long h = hash_name(name, length, m_Salt);
+		const entry &e = m_Entries[slot_of(h, m_Seeds[bucket_of(h)])];
+		return e.length == length && memcmp(e.name, name, length) == 0 ? &e : 0;
+	}
+
+	// Finds a seed for every bucket, biggest buckets first. order[i] receives
+	// the slot of the i-th pending name. Fails if a bucket can't be placed
+	// (two names with the same hash), build() retries with another salt.
+	bool place(std::vector<size_t> &order)
+	{
+		size_t n = m_Pending.size();
+		m_Seeds.assign(m_Seeds.size(), 0);
+		std::vector<unsigned long long> hashes(n);
+		std::vector< std::vector<size_t> > buckets(m_Seeds.size());
+		for(size_t i = 0; i != n; ++i)
+		{
+			hashes[i] = hash_name(m_Pending[i].name.data(), m_Pending[i].name.size(), m_Salt);
+			buckets[bucket_of(hashes[i])].push_back(i);
+		}
+
+		std::vector<size_t> by_size(buckets.size());
+		for(size_t b = 0; b != buckets.size(); ++b)
+			by_size[b] = b;
+		std::stable_sort(by_size.begin(), by_size.end(), [&buckets](size_t x, size_t y) { return buckets[x].size() > buckets[y].size(); });
+
+		// The last buckets need about n tries to hit one of the few free slots
+		const unsigned max_seed = unsigned(n) * 64 + 1024;
+		std::vector<bool> taken(n, false);
+		std::vector<size_t> slots;
+		for(size_t k = 0; k != by_size.size() && !buckets[by_size[k]].empty(); ++k)
+		{
+			const std::vector<size_t> &bucket = buckets[by_size[k]];
+			unsigned seed = 0;
+			for(; seed != max_seed; ++seed)
+			{
+				slots.clear();
+				for(size_t i = 0; i != bucket.size(); ++i)
+				{
+					size_t s = slot_of(hashes[bucket[i]], seed);
+					if(taken[s] || std::find(slots.begin(), slots.end(), s) != slots.end())
+						break;
+					slots.push_back(s);
+				}
+				if(slots.size() == bucket.size())
+					break;
+			}
+			if(seed == max_seed)
+				return false;
+
+			m_Seeds[by_size[k]] = seed;
+			for(size_t i = 0; i != bucket.size(); ++i)
+			{
+				taken[slots[i]] = true;
+				order[bucket[i]] = slots[i];
+			}
+		}
+		return true;
+	}
+
+	std::vector<pending_entry> m_Pending;
+	std::vector<entry> m_Entries;
+	std::vector<unsigned> m_Seeds;
+	std::string m_Names;
+	unsigned m_Salt;
+	unsigned m_Generation;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+}
+
+#endif //_SF_DELEGATE_REGISTRY_H__
@@ -0,0 +1,128 @@
+#ifndef _DELEGATE_SIGNATURE_H__
+#define _DELEGATE_SIGNATURE_H__
+
+#include "delegate_frame.h"
+#include "typetraits.h"
+
+//////////////////////////////////////////////////////////////////////////
+// Signature descriptors
+//////////////////////////////////////////////////////////////////////////
+
+// Layout of a single parameter or of the return value as seen by
+// delegate_dynamic_base::invoke(): args[N] points to an object of 'size'
+// bytes. For references that is the referred object, pointers are passed
+// as pointer values.
+struct type_desc
+{
+	size_t size;
+	size_t align;
+	bool is_const;
+	bool is_ref;
+	bool is_ptr;
+	// Id of the referred type without cv-qualifiers, equal for T, const T& and T&
+	uint64_t type_id;
+};
+
+// Everything a marshalling layer needs to know before calling invoke().
+// Descriptors are built at compile time and stored statically, one per
+// signature, so they can be compared by address.
+struct signature_desc
+{
+	size_t arity;
+	type_desc ret;			// size is 0 for void
+	const type_desc *args;	// 'arity' elements
+	uint64_t hash;			// hash of the exact signature
+
+	// Argument frame layout, see frame_layout<>
+	size_t frame_size;
+	size_t frame_align;
+	const size_t *frame_offsets;	// 'arity' elements
+};
+
+namespace detail
+{
+	// Polynomial string hash, evaluated by halves so the constexpr
+	// recursion depth stays logarithmic in the name length
+	static const uint64_t SIG_HASH_BASE = 1099511628211ULL;
+
+	constexpr uint64_t sig_hash_pow(size_t n)
+	{
+		return n == 0 ? 1
+			: (n % 2 ? SIG_HASH_BASE : 1) * sig_hash_pow(n / 2) * sig_hash_pow(n / 2);
+	}
+
+	constexpr uint64_t sig_hash_range(const char *s, size_t b, size_t e)
+	{
+		return e - b == 0 ? 0
+			: e - b == 1 ? static_cast<unsigned char>(s[b])
+			: sig_hash_range(s, b, b + (e - b) / 2) * sig_hash_pow(e - b - (e - b) / 2)
+				+ sig_hash_range(s, b + (e - b) / 2, e);
+	}
+
+	// The decorated name of this function spells out T, it is the same in every
+	// translation unit of a build (but differs between compilers)
+	template<class T>
+	constexpr uint64_t type_hash()
+	{
+		return sig_hash_range(FASTDLGT_FUNCSIG, 0, sizeof(FASTDLGT_FUNCSIG) - 1);
+	}
+
+	template<class T>
+	struct type_desc_of
+	{
+		typedef typename t_strip<T>::noref stored;
+
+		static constexpr type_desc value()
+		{
+			return type_desc { sizeof(stored), std::alignment_of<stored>::value,
+				t_strip<T>::is_const, t_strip<T>::is_ref, t_strip<T>::is_ptr,
+				type_hash<typename std::remove_cv<stored>::type>() };
+		}
+	};
+
+	template<>
+	struct type_desc_of<void>
+	{
+		static constexpr type_desc value() { return type_desc { 0, 0, false, false, false, type_hash<void>() }; }
+	};
+
+	// Offsets of all arguments in the frame, the frame size is the last element
+	template<class Layout, class Indices>
+	struct frame_offsets;
+
+	template<class Layout, size_t... I>
+	struct frame_offsets<Layout, index_list<I...> >
+	{
+		static constexpr size_t value[sizeof...(I) + 1] = { Layout::template arg<I>::offset..., Layout::size };
+	};
+
+	template<class Layout, size_t... I>
+	constexpr size_t frame_offsets<Layout, index_list<I...> >::value[sizeof...(I) + 1];
+}
+
+// signature_of< R (Params...) >::value is the descriptor of the signature
+template <typename Signature> struct signature_of;
+
+template<class R, class... Params>
+struct signature_of< R (Params...) >
+{
+private:
+	typedef frame_layout< R (Params...) > layout;
+	typedef detail::frame_offsets<layout, typename detail::make_index_list<sizeof...(Params)>::type> offsets;
+
+public:
+	// One extra element, so the array isn't empty for the parameterless signature
+	static constexpr type_desc args[sizeof...(Params) + 1] = { detail::type_desc_of<Params>::value()..., detail::type_desc_of<void>::value() };
+	static constexpr signature_desc value = { sizeof...(Params), detail::type_desc_of<R>::value(), args, detail::type_hash<R (Params...)>(),
+		layout::size, layout::align, offsets::value };
+};
+
+template<class R, class... Params>
+constexpr type_desc signature_of< R (Params...) >::args[sizeof...(Params) + 1];
+
+template<class R, class... Params>
+constexpr signature_desc signature_of< R (Params...) >::value;
+
+//////////////////////////////////////////////////////////////////////////
+
+#endif //_DELEGATE_SIGNATURE_H__
@@ -0,0 +1,388 @@
+#ifndef _DELEGATE_STATS_H__
+#define _DELEGATE_STATS_H__
+
+//////////////////////////////////////////////////////////////////////////
+// Call statistics and tracing (FASTDELEGATE_CALL_STATS, FASTDELEGATE_CALL_TRACE)
+//////////////////////////////////////////////////////////////////////////
+
+// With FASTDELEGATE_CALL_STATS every delegate call is timed and attributed to
+// its target (detail::target_id). Each thread records into a table of its own,
+// so recording takes no locks and no atomic read-modify-write operations:
+// only the owning thread writes the counters, readers load them relaxed.
+// Entries are padded to whole cache lines. Reading and resetting the
+// aggregated numbers is in delegate_call_stats.h.
+//
+// With FASTDELEGATE_CALL_TRACE every call also leaves a 32-byte record (start,
+// duration, thread, target) in a ring buffer of the calling thread, the oldest
+// records get overwritten. The collector in delegate_call_trace.h copies the
+// rings and exports them as Chrome trace events.
+//
+// Tables and rings of finished threads are handed to new threads, they're
+// never freed. Where the compiler offers the time stamp counter (x86 GCC /
+// Clang), calls are timed in TSC ticks, which are scaled to nanoseconds with
+// a factor measured against steady_clock once (a 2 ms busy wait at the first
+// call). Elsewhere steady_clock is read directly.
+
+// Times the calls in the current scope and attributes them to the closure
+#if defined(FASTDELEGATE_CALL_STATS) || defined(FASTDELEGATE_CALL_TRACE)
+#	define FASTDLGT_TIME_CALLS(closure, calls) detail::call_timer fastdlgt_call_timer_((closure), (calls))
+#else
+#	define FASTDLGT_TIME_CALLS(closure, calls)
+#endif
+
+// Latency buckets: bucket N counts calls of [2^N, 2^(N+1)) nanoseconds,
+// bucket 0 includes 0, the last one everything above
+static const size_t CALL_STATS_BUCKETS = 32;
+
+// Number of targets each thread can record, further targets are only counted
+#if !defined(FASTDELEGATE_CALL_STATS_TARGETS)
+#	define FASTDELEGATE_CALL_STATS_TARGETS 256
+#endif
+
+// Number of records in the trace ring of each thread
+#if !defined(FASTDELEGATE_CALL_TRACE_RECORDS)
+#	define FASTDELEGATE_CALL_TRACE_RECORDS 16384
+#endif
+
+#if defined(FASTDELEGATE_CALL_STATS) || defined(FASTDELEGATE_CALL_TRACE)
+
+namespace detail
+{
+	typedef std::chrono::steady_clock call_clock;
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	inline unsigned long long call_clock_ticks() { return __builtin_ia32_rdtsc(); }
+
+	// Nanoseconds per tick
+	inline double measure_call_clock_scale()
+	{
+		call_clock::time_point start = call_clock::now(), now;
+		unsigned long long ticks = call_clock_ticks();
+		while((now = call_clock::now()) - start < std::chrono::milliseconds(2))
+			;
+		ticks = call_clock_ticks() - ticks;
+		return ticks ? std::chrono::duration<double, std::nano>(now - start).count() / double(ticks) : 1.0;
+	}
+#else
+	inline unsigned long long call_clock_ticks()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(call_clock::now().time_since_epoch()).count();
+	}
+
+	inline double measure_call_clock_scale() { return 1.0; }
+#endif
+
+	inline double call_clock_scale()
+	{
+		static const double scale = measure_call_clock_scale();
+		return scale;
+	}
+
+	// Single writer, so increments don't need to be atomic
+	template<class T>
+	inline void call_stats_add(std::atomic<T> &counter, T n)
+	{
+		counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+	}
+
+	// Per-thread records (statistics tables, trace rings), linked into a global
+	// list for the readers. A thread takes one left by a finished thread or
+	// allocates a new one, zeroed and aligned to a cache line.
+	class thread_record
+	{
+	public:
+		const thread_record* next() const { return m_Next; }
+		void release() { m_InUse.store(false, std::memory_order_release); }
+
+	protected:
+		thread_record() { }
+
+		template<class T>
+		static T& acquire(std::atomic<thread_record*> &list)
+		{
+			for(thread_record *r = list.load(std::memory_order_acquire); r; r = r->m_Next)
+			{
+				bool expected = false;
+				if(!r->m_InUse.load(std::memory_order_relaxed) && r->m_InUse.compare_exchange_strong(expected, true))
+					return static_cast<T&>(*r);
+			}
+			char *raw = new char[sizeof(T) + CACHE_LINE_SIZE]();
+			T *t = new (raw + CACHE_LINE_SIZE - reinterpret_cast<uintptr_t>(raw) % CACHE_LINE_SIZE) T();
+			t->m_InUse.store(true, std::memory_order_relaxed);
+			t->m_Next = list.load(std::memory_order_relaxed);
+			while(!list.compare_exchange_weak(t->m_Next, t, std::memory_order_release, std::memory_order_relaxed))
+				;
+			return *t;
+		}
+
+	private:
+		thread_record(const thread_record &);
+		void operator = (const thread_record &);
+
+		std::atomic<bool> m_InUse;
+		thread_record *m_Next;
+	};
+
+	// The calling thread's record of type T
+	template<class T>
+	class thread_record_holder
+	{
+	public:
+		thread_record_holder() : m_Record(T::acquire()) { }
+		~thread_record_holder() { m_Record.release(); }
+
+		static T& get()
+		{
+			static thread_local thread_record_holder holder;
+			return holder.m_Record;
+		}
+
+	private:
+		thread_record_holder(const thread_record_holder &);
+		void operator = (const thread_record_holder &);
+		T &m_Record;
+	};
+}
+
+#endif
+
+#if defined(FASTDELEGATE_CALL_STATS)
+
+namespace detail
+{
+	inline size_t call_bucket(unsigned long long ns)
+	{
+		if(ns < 2)
+			return 0;
+#if defined(__GNUC__)
+		size_t b = 63 - __builtin_clzll(ns);
+#else
+		size_t b = 0;
+		while(ns >>= 1)
+			++b;
+#endif
+		return b < CALL_STATS_BUCKETS ? b : CALL_STATS_BUCKETS - 1;
+	}
+
+	struct call_stats_counters
+	{
+		std::atomic<bool> used;		// set by the owning thread after 'target' and 'code'
+		target_id target;
+		const void *code;			// what the target ran, see target_code_address()
+		std::atomic<unsigned long long> calls;
+		std::atomic<unsigned long long> total_ns;
+		std::atomic<unsigned long long> buckets[CALL_STATS_BUCKETS];
+	};
+
+	struct call_stats_entry : call_stats_counters
+	{
+		char padding[CACHE_LINE_SIZE - sizeof(call_stats_counters) % CACHE_LINE_SIZE];
+	};
+
+	class call_stats_table : public thread_record
+	{
+	public:
+		static const size_t capacity = FASTDELEGATE_CALL_STATS_TARGETS;
+		static_assert((capacity & (capacity - 1)) == 0, "FASTDELEGATE_CALL_STATS_TARGETS must be a power of two");
+
+		void record(const target_id &id, size_t calls, unsigned long long ticks)
+		{
+			unsigned long long ns = static_cast<unsigned long long>(double(ticks) * m_Scale);
+			size_t i = static_cast<size_t>(((reinterpret_cast<uintptr_t>(id.object) ^ id.function[0]) * 0x9e3779b97f4a7c15ULL) >> 40) & (capacity - 1);
+			for(size_t probe = 0; probe != capacity; ++probe, i = (i + 1) & (capacity - 1))
+			{
+				call_stats_entry &e = m_Entries[i];
+				if(!e.used.load(std::memory_order_relaxed))
+				{
+					// Resolved while the object is known to be alive, the
+					// readers never look at the object itself
+					e.target = id;
+					e.code = target_code_address(id);
+					e.used.store(true, std::memory_order_release);
+				}
+				else if(!(e.target == id))
+					continue;
+				call_stats_add(e.calls, static_cast<unsigned long long>(calls));
+				call_stats_add(e.total_ns, ns);
+				call_stats_add(e.buckets[call_bucket(ns / calls)], static_cast<unsigned long long>(calls));
+				return;
+			}
+			call_stats_add(m_Dropped, static_cast<unsigned long long>(calls));
+		}
+
+		template<class F>
+		void for_each_entry(F f) const
+		{
+			for(size_t i = 0; i != capacity; ++i)
+				if(m_Entries[i].used.load(std::memory_order_acquire))
+					f(m_Entries[i]);
+		}
+
+		unsigned long long dropped() const { return m_Dropped.load(std::memory_order_relaxed); }
+
+		static std::atomic<thread_record*>& list()
+		{
+			static std::atomic<thread_record*> head(0);
+			return head;
+		}
+
+		static call_stats_table& acquire()
+		{
+			call_stats_table &t = thread_record::acquire<call_stats_table>(list());
+			t.m_Scale = call_clock_scale();
+			return t;
+		}
+
+	private:
+		friend class thread_record;
+		// Constructed in zeroed storage, the counters are left alone
+		call_stats_table() { }
+
+		call_stats_entry m_Entries[capacity];
+		std::atomic<unsigned long long> m_Dropped;
+		double m_Scale;
+	};
+}
+
+#endif
+
+#if defined(FASTDELEGATE_CALL_TRACE)
+
+namespace detail
+{
+	// One call. The fields are atomics because the collector may read a record
+	// while it's being overwritten, such records are detected and skipped.
+	struct call_trace_record
+	{
+		std::atomic<unsigned long long> start;		// ticks
+		std::atomic<unsigned long long> thread_duration;	// thread number << 32 | ticks (saturated)
+		std::atomic<unsigned long long> object;
+		std::atomic<unsigned long long> function;	// first word of the member function pointer
+	};
+
+	inline std::atomic<bool>& call_trace_enabled()
+	{
+		static std::atomic<bool> enabled(true);
+		return enabled;
+	}
+
+	class call_trace_ring : public thread_record
+	{
+	public:
+		static const size_t capacity = FASTDELEGATE_CALL_TRACE_RECORDS;
+		static_assert((capacity & (capacity - 1)) == 0, "FASTDELEGATE_CALL_TRACE_RECORDS must be a power of two");
+
+		void record(const target_id &id, unsigned long long start, unsigned long long end)
+		{
+			if(!call_trace_enabled().load(std::memory_order_relaxed))
+				return;
+			unsigned long long duration = end - start;
+			if(duration > 0xffffffffULL)
+				duration = 0xffffffffULL;
+			unsigned long long head = m_Head.load(std::memory_order_relaxed);
+			call_trace_record &r = m_Records[head & (capacity - 1)];
+			// Claim the slot first, readers skip records below head - capacity
+			m_Head.store(head + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			r.start.store(start, std::memory_order_relaxed);
+			r.thread_duration.store(static_cast<unsigned long long>(m_Thread) << 32 | duration, std::memory_order_relaxed);
+			r.object.store(reinterpret_cast<uintptr_t>(id.object), std::memory_order_relaxed);
+			r.function.store(id.function[0], std::memory_order_relaxed);
+			m_Written.store(head + 1, std::memory_order_release);
+		}
+
+		// Calls f(record fields) for the records written since position 'from'
+		// which are still in the ring, oldest first. Returns the position to
+		// continue from.
+		template<class F>
+		unsigned long long read(unsigned long long from, F f) const
+		{
+			unsigned long long written = m_Written.load(std::memory_order_acquire);
+			if(written - from > capacity)
+				from = written - capacity;
+			for(unsigned long long i = from; i != written; ++i)
+			{
+				const call_trace_record &r = m_Records[i & (capacity - 1)];
+				unsigned long long start = r.start.load(std::memory_order_relaxed);
+				unsigned long long thread_duration = r.thread_duration.load(std::memory_order_relaxed);
+				unsigned long long object = r.object.load(std::memory_order_relaxed);
+				unsigned long long function = r.function.load(std::memory_order_relaxed);
+				// Skip the record if the writer has claimed its slot again meanwhile
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if(m_Head.load(std::memory_order_relaxed) - i > capacity)
+					continue;
+				f(unsigned(thread_duration >> 32), start, thread_duration & 0xffffffffULL, object, function);
+			}
+			return written;
+		}
+
+		unsigned long long position() const { return m_Written.load(std::memory_order_acquire); }
+
+		static std::atomic<thread_record*>& list()
+		{
+			static std::atomic<thread_record*> head(0);
+			return head;
+		}
+
+		// Every thread taking a ring gets a new number, so the records of
+		// a recycled ring keep the thread which wrote them
+		static call_trace_ring& acquire()
+		{
+			static std::atomic<unsigned> threads(0);
+			call_trace_ring &r = thread_record::acquire<call_trace_ring>(list());
+			r.m_Thread = ++threads;
+			return r;
+		}
+
+	private:
+		friend class thread_record;
+		// Constructed in zeroed storage
+		call_trace_ring() { }
+
+		std::atomic<unsigned long long> m_Head;		// claimed by the writer
+		std::atomic<unsigned long long> m_Written;	// completely written
+		unsigned m_Thread;							// only used by the owning thread
+		char m_Padding[CACHE_LINE_SIZE];
+		call_trace_record m_Records[capacity];
+	};
+}
+
+#endif
+
+#if defined(FASTDELEGATE_CALL_STATS) || defined(FASTDELEGATE_CALL_TRACE)
+
+namespace detail
+{
+	class call_timer
+	{
+	public:
+		// The target is taken before the call, which may destroy the delegate
+		explicit call_timer(const function_data &fd, size_t calls = 1)
+			: m_Target(fd.GetTargetId()), m_Calls(calls), m_Start(call_clock_ticks()) { }
+
+		~call_timer()
+		{
+			if(m_Calls == 0)
+				return;
+			unsigned long long end = call_clock_ticks();
+#if defined(FASTDELEGATE_CALL_STATS)
+			thread_record_holder<call_stats_table>::get().record(m_Target, m_Calls, end - m_Start);
+#endif
+#if defined(FASTDELEGATE_CALL_TRACE)
+			thread_record_holder<call_trace_ring>::get().record(m_Target, m_Start, end);
+#endif
+		}
+
+	private:
+		call_timer(const call_timer &);
+		void operator = (const call_timer &);
+
+		target_id m_Target;
+		size_t m_Calls;
+		unsigned long long m_Start;
+	};
+}
+
+#endif
+
+#endif //_DELEGATE_STATS_H__
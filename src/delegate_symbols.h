@@ -0,0 +1,354 @@
+#ifndef _SF_DELEGATE_SYMBOLS_H__
+#define _SF_DELEGATE_SYMBOLS_H__
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#if defined(__linux__) || defined(__APPLE__)
+#	include <cxxabi.h>
+#	include <dlfcn.h>
+#	define FASTDLGT_HAS_DLADDR
+#endif
+#if defined(__linux__)
+#	include <elf.h>
+#	include <errno.h>
+#	include <link.h>
+#	define FASTDLGT_HAS_ELF_SYMTAB
+#endif
+#include "delegate.h"
+
+namespace delegates
+{
+
+//////////////////////////////////////////////////////////////////////////
+// Symbolization of delegate targets
+//////////////////////////////////////////////////////////////////////////
+
+// Resolves the code address of a delegate target to a demangled function
+// name and the binary it comes from, for labelling profiles and traces:
+//
+//		const code_symbol &s = resolve_target_symbol(d);
+//		printf("%s (%s)\n", s.name.c_str(), s.module.c_str());
+//
+// On Linux the address is looked up with dladdr(), which only knows the
+// exported (dynamic) symbols. Anything else is searched in the ELF symbol
+// table (.symtab) of the module, so executables need neither -rdynamic nor
+// debug info, they just mustn't be stripped. Static functions are found
+// behind the invoker the closure calls, with and without
+// FASTDELEGATE_USESTATICFUNCTIONHACK. Compile-time targets show up as the
+// thunk made for them, with the target among its template arguments. Virtual
+// functions bound under the Itanium ABI are looked up in the vtable of the
+// object, which must still be alive then.
+//
+// Results are cached in a lock-free open-addressing table of
+// FASTDELEGATE_SYMBOL_CACHE_SIZE slots (then in a map behind a lock), so a
+// repeated lookup costs a hash and a few loads. Entries are never freed, the
+// references stay valid. Where nothing is found, or elsewhere than Linux /
+// macOS, the name is the address in hex.
+
+// Slots of the lookup cache, a power of 2
+#if !defined(FASTDELEGATE_SYMBOL_CACHE_SIZE)
+#	define FASTDELEGATE_SYMBOL_CACHE_SIZE 4096
+#endif
+
+struct code_symbol
+{
+	const void *address;	// the address looked up
+	std::string name;		// demangled function name, the address in hex if unknown
+	std::string module;		// path of the executable or shared library, empty if unknown
+	size_t offset;			// of the address from the start of the function
+	bool resolved;			// false if the name is just the address
+};
+
+namespace detail
+{
+	struct symbol_entry
+	{
+		code_symbol symbol;
+		// delegate<>::InvokeStaticFunction, the static function is in the object
+		bool static_invoker;
+	};
+
+	inline std::string demangle_symbol(const char *mangled)
+	{
+#if defined(FASTDLGT_HAS_DLADDR)
+		int status = 0;
+		char *demangled = abi::__cxa_demangle(mangled, 0, 0, &status);
+		if(demangled)
+		{
+			std::string name(demangled);
+			free(demangled);
+			return name;
+		}
+#endif
+		return mangled;
+	}
+
+#if defined(FASTDLGT_HAS_ELF_SYMTAB)
+	// Function symbols from the .symtab of one module, sorted by address
+	struct elf_symbols
+	{
+		struct function
+		{
+			uintptr_t start;
+			size_t size;
+			size_t name;		// offset into names
+		};
+
+		std::vector<function> functions;
+		std::vector<char> names;
+		bool relative;			// ET_DYN: symbol values are offsets from the load address
+
+		elf_symbols() : relative(false) { }
+
+		const function* find(uintptr_t value) const
+		{
+			std::vector<function>::const_iterator it = std::upper_bound(functions.begin(), functions.end(), value,
+				[](uintptr_t v, const function &f) { return v < f.start; });
+			if(it == functions.begin())
+				return 0;
+			--it;
+			return value - it->start < std::max<size_t>(it->size, 1) ? &*it : 0;
+		}
+
+		static bool read_at(FILE *f, size_t offset, void *to, size_t size)
+		{
+			return fseek(f, static_cast<long>(offset), SEEK_SET) == 0 && fread(to, 1, size, f) == size;
+		}
+
+		void load(const char *path)
+		{
+			FILE *f = fopen(path, "rb");
+			if(!f)
+				return;
+			ElfW(Ehdr) header;
+			std::vector<ElfW(Shdr)> sections;
+			if(read_at(f, 0, &header, sizeof(header)) && !memcmp(header.e_ident, ELFMAG, SELFMAG)
+				&& header.e_ident[EI_CLASS] == (sizeof(void*) == 8 ? ELFCLASS64 : ELFCLASS32)
+				&& header.e_shentsize == sizeof(ElfW(Shdr)) && header.e_shnum != 0)
+			{
+				relative = header.e_type == ET_DYN;
+				sections.resize(header.e_shnum);
+				if(!read_at(f, header.e_shoff, &sections[0], sections.size() * sizeof(ElfW(Shdr))))
+					sections.clear();
+			}
+
+			for(size_t i = 0; i != sections.size(); ++i)
+			{
+				const ElfW(Shdr) &table = sections[i];
+				if(table.sh_type != SHT_SYMTAB || table.sh_entsize != sizeof(ElfW(Sym)) || table.sh_link >= sections.size())
+					continue;
+				const ElfW(Shdr) &strings = sections[table.sh_link];
+				std::vector<ElfW(Sym)> symbols(table.sh_size / sizeof(ElfW(Sym)));
+				names.assign(strings.sh_size + 1, 0);
+				if(symbols.empty() || !read_at(f, table.sh_offset, &symbols[0], symbols.size() * sizeof(ElfW(Sym)))
+					|| !read_at(f, strings.sh_offset, &names[0], strings.sh_size))
+				{
+					names.clear();
+					break;
+				}
+				for(size_t s = 0; s != symbols.size(); ++s)
+				{
+					if(ELF32_ST_TYPE(symbols[s].st_info) != STT_FUNC || symbols[s].st_value == 0 || symbols[s].st_name >= strings.sh_size)
+						continue;
+					function fn = { static_cast<uintptr_t>(symbols[s].st_value), static_cast<size_t>(symbols[s].st_size), symbols[s].st_name };
+					functions.push_back(fn);
+				}
+				break;
+			}
+			fclose(f);
+			std::sort(functions.begin(), functions.end(), [](const function &x, const function &y) { return x.start < y.start; });
+		}
+	};
+
+	// Symbol tables are read once per module, never freed
+	inline const elf_symbols& get_elf_symbols(const char *path)
+	{
+		static std::mutex lock;
+		static std::map<std::string, elf_symbols*> *modules = new std::map<std::string, elf_symbols*>();
+		std::lock_guard<std::mutex> guard(lock);
+		elf_symbols *&m = (*modules)[path];
+		if(!m)
+		{
+			m = new elf_symbols();
+			// dladdr() names the executable after argv[0], which may be relative
+			m->load(strcmp(path, program_invocation_name) == 0 ? "/proc/self/exe" : path);
+		}
+		return *m;
+	}
+#endif
+
+	// The uncached lookup
+	inline symbol_entry* lookup_symbol(const void *address)
+	{
+		symbol_entry *e = new symbol_entry();
+		code_symbol &s = e->symbol;
+		s.address = address;
+		s.offset = 0;
+		s.resolved = false;
+		e->static_invoker = false;
+
+		const char *mangled = 0;
+#if defined(FASTDLGT_HAS_DLADDR)
+		Dl_info info;
+		if(address && dladdr(const_cast<void*>(address), &info))
+		{
+			if(info.dli_fname)
+				s.module = info.dli_fname;
+			if(info.dli_sname && info.dli_saddr)
+			{
+				mangled = info.dli_sname;
+				s.offset = static_cast<const char*>(address) - static_cast<const char*>(info.dli_saddr);
+			}
+#if defined(FASTDLGT_HAS_ELF_SYMTAB)
+			else if(info.dli_fname)
+			{
+				const elf_symbols &m = get_elf_symbols(info.dli_fname);
+				uintptr_t value = reinterpret_cast<uintptr_t>(address) - (m.relative ? reinterpret_cast<uintptr_t>(info.dli_fbase) : 0);
+				if(const elf_symbols::function *f = m.find(value))
+				{
+					mangled = &m.names[f->name];
+					s.offset = value - f->start;
+				}
+			}
+#endif
+		}
+#endif
+
+		if(mangled)
+		{
+			s.name = demangle_symbol(mangled);
+			s.resolved = true;
+			e->static_invoker = strstr(mangled, "InvokeStaticFunction") != 0;
+		}
+		else
+		{
+			char hex[32];
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+			// Itanium ABI: an odd member function "address" is the vtable offset + 1
+			if(reinterpret_cast<uintptr_t>(address) & 1)
+				snprintf(hex, sizeof(hex), "virtual #%u", unsigned((reinterpret_cast<uintptr_t>(address) - 1) / sizeof(void*)));
+			else
+#endif
+			snprintf(hex, sizeof(hex), "%p", address);
+			s.name = hex;
+		}
+		return e;
+	}
+
+	class symbol_cache
+	{
+	public:
+		static const symbol_entry& get(const void *address)
+		{
+			static_assert((FASTDELEGATE_SYMBOL_CACHE_SIZE & (FASTDELEGATE_SYMBOL_CACHE_SIZE - 1)) == 0, "FASTDELEGATE_SYMBOL_CACHE_SIZE must be a power of 2");
+			symbol_cache &cache = instance();
+			const size_t mask = FASTDELEGATE_SYMBOL_CACHE_SIZE - 1;
+			size_t slot = static_cast<size_t>(hash_mix(reinterpret_cast<uintptr_t>(address))) & mask;
+			symbol_entry *fresh = 0;
+			for(size_t probe = 0; probe != FASTDELEGATE_SYMBOL_CACHE_SIZE; ++probe, slot = (slot + 1) & mask)
+			{
+				const symbol_entry *e = cache.m_Slots[slot].load(std::memory_order_acquire);
+				if(!e)
+				{
+					// Resolved outside of any lock, a thread losing the race drops its copy
+					if(!fresh)
+						fresh = lookup_symbol(address);
+					if(cache.m_Slots[slot].compare_exchange_strong(e, fresh, std::memory_order_acq_rel, std::memory_order_acquire))
+						return *fresh;
+				}
+				if(e->symbol.address == address)
+				{
+					delete fresh;
+					return *e;
+				}
+			}
+			return cache.overflow(address, fresh);
+		}
+
+	private:
+		symbol_cache()
+		{
+			for(size_t i = 0; i != FASTDELEGATE_SYMBOL_CACHE_SIZE; ++i)
+				m_Slots[i].store(0, std::memory_order_relaxed);
+		}
+
+		// Never destroyed, reports may be written during static destruction
+		static symbol_cache& instance()
+		{
+			static symbol_cache *cache = new symbol_cache();
+			return *cache;
+		}
+
+		const symbol_entry& overflow(const void *address, symbol_entry *fresh)
+		{
+			std::lock_guard<std::mutex> lock(m_Lock);
+			symbol_entry *&e = m_Overflow[address];
+			if(!e)
+				e = fresh ? fresh : lookup_symbol(address);
+			else
+				delete fresh;
+			return *e;
+		}
+
+		std::atomic<const symbol_entry*> m_Slots[FASTDELEGATE_SYMBOL_CACHE_SIZE];
+		std::mutex m_Lock;
+		std::map<const void*, symbol_entry*> m_Overflow;
+	};
+
+	// Escapes a name for a JSON string
+	inline std::string json_escape(const std::string &s)
+	{
+		std::string out;
+		for(size_t i = 0; i != s.size(); ++i)
+		{
+			if(s[i] == '"' || s[i] == '\\')
+				out += '\\';
+			if(static_cast<unsigned char>(s[i]) >= 0x20)
+				out += s[i];
+		}
+		return out;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+inline const code_symbol& resolve_code_symbol(const void *address)
+{
+	return detail::symbol_cache::get(address).symbol;
+}
+
+// The function a target runs, given the object and the first word of the
+// member function pointer as call_trace_event keeps them. Without the rest of
+// the member function pointer virtual functions can't be looked up, they are
+// named by their vtable slot.
+inline const code_symbol& resolve_target_symbol(const void *object, const void *function)
+{
+	const detail::symbol_entry &e = detail::symbol_cache::get(function);
+	return e.static_invoker ? resolve_code_symbol(object) : e.symbol;
+}
+
+// The function a target runs, virtual ones as overridden by the object
+inline const code_symbol& resolve_target_symbol(const detail::target_id &target)
+{
+	return resolve_target_symbol(target.object, detail::target_code_address(target));
+}
+
+template<class Signature>
+inline const code_symbol& resolve_target_symbol(const delegate<Signature> &d)
+{
+	return resolve_target_symbol(d.getFunctionData().GetTargetId());
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+}
+
+#endif //_SF_DELEGATE_SYMBOLS_H__
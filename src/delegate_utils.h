@@ -54,6 +54,22 @@ namespace detail {	// we'll hide the implementation details in a nested namespac
 
 	////////////////////////////////////////////////////////////////////////////////
 
+	// Compile-time list of indices 0..N-1, used to expand parameter packs
+	// together with their positions (e.g. when unpacking argument arrays).
+	template <size_t... I>
+	struct index_list { };
+
+	template <size_t N, size_t... I>
+	struct make_index_list : make_index_list<N - 1, N - 1, I...> { };
+
+	template <size_t... I>
+	struct make_index_list<0, I...>
+	{
+		typedef index_list<I...> type;
+	};
+
+	////////////////////////////////////////////////////////////////////////////////
+
 
 	////////////////////////////////////////////////////////////////////////////////
 	// Workarounds
@@ -122,10 +138,77 @@ namespace detail {	// we'll hide the implementation details in a nested namespac
 		template <class X, class XFuncType, class GenericMemFuncType>
 		inline static GenericClass *Convert(X *pthis, XFuncType function_to_bind, GenericMemFuncType &bound_func) 
 		{
-			static_assert(false, "Unsupported member function pointer on this compiler");
+			static_assert(sizeof(XFuncType) == 0, "Unsupported member function pointer on this compiler");
+			return 0;
 		}
 	};
 
+	////////////////////////////////////////////////////////////////////////////////
+	//						ResolveItaniumMemFunc()
+	//
+	//	An Itanium C++ ABI member function pointer is a pair { ptr, adj }: the code
+	//	address and the adjustment of 'this'. For a virtual function ptr holds
+	//	1 + the offset of its vtable slot instead (on ARM, where code addresses
+	//	may be odd, the flag is the lowest bit of adj and the adjustment is
+	//	shifted left by one). Every call through it tests the flag, adjusts
+	//	'this' and, for virtual functions, loads the vtable entry.
+	//	With FASTDELEGATE_RESOLVE_VIRTUALS all of that happens once, at bind time:
+	//	the closure gets the adjusted 'this' and the final code address, so the
+	//	call is a plain indirect call. The object must be fully constructed when
+	//	the delegate is bound. Bound during a constructor or destructor the
+	//	delegate keeps calling the function of that stage, not the override which
+	//	was current at call time.
+
+#if defined(FASTDELEGATE_RESOLVE_VIRTUALS) && defined(FASTDLGT_ITANIUM_ABI) && !defined(FASTDLGT_MICROSOFT_MFP) && \
+	(defined(__x86_64__) || defined(__i386__) || defined(__aarch64__) || defined(__arm__))
+#	define FASTDLGT_RESOLVE_ITANIUM_MFP
+
+	struct itanium_memfunc
+	{
+		intptr_t ptr;
+		intptr_t adj;
+	};
+
+FASTDLGT_BEGIN_MFP_TRICKS
+	// X is the class the function was bound with, only polymorphic classes
+	// have virtual functions to look up
+	template <class X, class GenericMemFuncType>
+	inline GenericClass *ResolveItaniumMemFunc(X *pthis, GenericMemFuncType &bound_func)
+	{
+		static_assert(sizeof(GenericMemFuncType) == sizeof(itanium_memfunc), "Unexpected member function pointer layout");
+		itanium_memfunc m;
+		memcpy(&m, &bound_func, sizeof(m));
+#if defined(__aarch64__) || defined(__arm__)
+		const bool is_virtual = (m.adj & 1) != 0;
+		const intptr_t adj = m.adj >> 1, slot = m.ptr;
+#else
+		const bool is_virtual = (m.ptr & 1) != 0;
+		const intptr_t adj = m.adj, slot = m.ptr - 1;
+#endif
+		// Compile-time targets have no object to look into, and a plain
+		// function of a class without bases needs nothing resolved
+		if (pthis == 0 || (!std::is_polymorphic<X>::value && adj == 0))
+			return reinterpret_cast<GenericClass *>(pthis);
+		char *object = reinterpret_cast<char *>(pthis) + adj;
+		if (std::is_polymorphic<X>::value && is_virtual)
+		{
+			const char *vtable;
+			memcpy(&vtable, object, sizeof(vtable));
+			memcpy(&m.ptr, vtable + slot, sizeof(m.ptr));
+#if !defined(__aarch64__) && !defined(__arm__)
+			// Code at an odd address (a thunk of an unoptimized build) would be
+			// taken for a vtable slot again, such functions stay unresolved
+			if (m.ptr & 1)
+				return reinterpret_cast<GenericClass *>(pthis);
+#endif
+		}
+		m.adj = 0;
+		memcpy(&bound_func, &m, sizeof(m));
+		return reinterpret_cast<GenericClass *>(object);
+	}
+FASTDLGT_END_MFP_TRICKS
+#endif
+
 	// For compilers where all member func ptrs are the same size, everything goes here.
 	// For non-standard compilers, only single_inheritance classes go here.
 	template <>
@@ -140,9 +223,15 @@ namespace detail {	// we'll hide the implementation details in a nested namespac
 			// static_cast through an int, but the DOS compiler doesn't.
 			bound_func = horrible_cast<GenericMemFuncType>(function_to_bind);
 #else 
+FASTDLGT_BEGIN_MFP_TRICKS
 			bound_func = reinterpret_cast<GenericMemFuncType>(function_to_bind);
+FASTDLGT_END_MFP_TRICKS
 #endif
+#if defined(FASTDLGT_RESOLVE_ITANIUM_MFP)
+			return ResolveItaniumMemFunc(pthis, bound_func);
+#else
 			return reinterpret_cast<GenericClass *>(pthis);
+#endif
 		}
 	};
 
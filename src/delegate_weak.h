@@ -0,0 +1,211 @@
+#ifndef _SF_DELEGATE_WEAK_H__
+#define _SF_DELEGATE_WEAK_H__
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <utility>
+#include "delegate.h"
+
+namespace delegates
+{
+
+//////////////////////////////////////////////////////////////////////////
+// Weak delegates
+//////////////////////////////////////////////////////////////////////////
+
+// weak_delegate<> doesn't call its target once the target object has been
+// destroyed. Target classes derive from weak_target, or keep one as a member
+// and pass it explicitly:
+//
+//		struct View : weak_target { void SetProgress(float p); };
+//
+//		weak_delegate< void (float) > d = make_weak_delegate(&view, &View::SetProgress);
+//		d(0.5f);						// does nothing once the view is gone
+//
+//		weak_delegate< void (float) > d2(model.anchor, make_delegate(&model, &Model::Set));
+//
+// Every weak_target owns a liveness slot with a generation counter. Slots come
+// from a global pool and are never freed, so a delegate can still read the slot
+// after its target is gone. Destroying the target increments the generation
+// and returns the slot for reuse. A weak delegate remembers the generation
+// seen when it was bound and compares it before each call: one plain load and
+// compare, no reference counting.
+//
+// This guards against calls after the target is destroyed, not against the
+// target being destroyed by another thread during a call, which still needs
+// synchronization. The generation changes in ~weak_target(), after the derived
+// destructors, call invalidate_weak_refs() first if handlers may fire during
+// teardown. multicast_delegate<> skips dead weak subscribers and drops them
+// on the next change of its list.
+
+namespace detail
+{
+	struct liveness_slot
+	{
+		std::atomic<size_t> generation;
+		liveness_slot *next_free;
+	};
+
+	// Slots are allocated in blocks and recycled, never freed
+	class liveness_pool
+	{
+	public:
+		static liveness_slot* acquire()
+		{
+			liveness_pool &pool = instance();
+			std::lock_guard<std::mutex> lock(pool.m_Lock);
+			if(!pool.m_Free)
+				pool.grow();
+			liveness_slot *s = pool.m_Free;
+			pool.m_Free = s->next_free;
+			return s;
+		}
+
+		static void release(liveness_slot *s)
+		{
+			s->generation.fetch_add(1, std::memory_order_release);
+			liveness_pool &pool = instance();
+			std::lock_guard<std::mutex> lock(pool.m_Lock);
+			s->next_free = pool.m_Free;
+			pool.m_Free = s;
+		}
+
+	private:
+		liveness_pool() : m_Free(0) { }
+
+		// Never destroyed, delegates in static objects may check their slots
+		// during static destruction
+		static liveness_pool& instance()
+		{
+			static liveness_pool *pool = new liveness_pool();
+			return *pool;
+		}
+
+		void grow()
+		{
+			const size_t count = 256;
+			liveness_slot *block = new liveness_slot[count];
+			for(size_t i = 0; i != count; ++i)
+			{
+				block[i].generation.store(0, std::memory_order_relaxed);
+				block[i].next_free = i + 1 != count ? &block[i + 1] : m_Free;
+			}
+			m_Free = block;
+		}
+
+		std::mutex m_Lock;
+		liveness_slot *m_Free;
+	};
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// Generation-checked reference to a weak_target
+class weak_ref
+{
+public:
+	weak_ref() : m_Slot(0), m_Generation(0) { }
+
+	// True while the target lives, false for a default-constructed reference
+	bool alive() const { return m_Slot && m_Slot->generation.load(std::memory_order_acquire) == m_Generation; }
+
+	// True only if there was a target and it is gone
+	bool expired() const { return m_Slot && m_Slot->generation.load(std::memory_order_acquire) != m_Generation; }
+
+	bool operator == (const weak_ref &x) const { return m_Slot == x.m_Slot && m_Generation == x.m_Generation; }
+	bool operator != (const weak_ref &x) const { return !(*this == x); }
+
+private:
+	friend class weak_target;
+	weak_ref(detail::liveness_slot *slot, size_t generation) : m_Slot(slot), m_Generation(generation) { }
+
+	detail::liveness_slot *m_Slot;
+	size_t m_Generation;
+};
+
+// Base class (or member) of objects which weak delegates may point to.
+// A copy is a different target, assignment keeps the identity.
+class weak_target
+{
+public:
+	weak_target() : m_Slot(detail::liveness_pool::acquire()) { }
+	weak_target(const weak_target &) : m_Slot(detail::liveness_pool::acquire()) { }
+	void operator = (const weak_target &) { }
+	~weak_target() { detail::liveness_pool::release(m_Slot); }
+
+	weak_ref get_weak_ref() const { return weak_ref(m_Slot, m_Slot->generation.load(std::memory_order_relaxed)); }
+
+	// Kills all weak references taken so far, the object stays usable
+	void invalidate_weak_refs() { m_Slot->generation.fetch_add(1, std::memory_order_release); }
+
+private:
+	detail::liveness_slot *m_Slot;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+template <typename Signature> class weak_delegate;
+
+template<class RetType, class... Params>
+class weak_delegate< RetType (Params...) >
+{
+public:
+	typedef delegate< RetType (Params...) > delegate_type;
+	typedef weak_delegate type;
+	typedef RetType result_type;
+
+	weak_delegate() { }
+	weak_delegate(const weak_ref &ref, const delegate_type &d) : m_Ref(ref), m_Delegate(d) { }
+	weak_delegate(const weak_target &target, const delegate_type &d) : m_Ref(target.get_weak_ref()), m_Delegate(d) { }
+
+	// Methods of classes derived from weak_target
+	template < class X, class Y >
+	weak_delegate(Y *pthis, RetType (X::* function_to_bind)(Params... params))
+		: m_Ref(target_of(pthis).get_weak_ref()), m_Delegate(pthis, function_to_bind) { }
+	template < class X, class Y >
+	weak_delegate(const Y *pthis, RetType (X::* function_to_bind)(Params... params) const)
+		: m_Ref(target_of(pthis).get_weak_ref()), m_Delegate(pthis, function_to_bind) { }
+
+	bool alive() const { return m_Ref.alive() && !m_Delegate.empty(); }
+	bool empty() const { return m_Delegate.empty(); }
+	void clear() { m_Ref = weak_ref(); m_Delegate.clear(); }
+
+	const weak_ref& ref() const { return m_Ref; }
+	const delegate_type& get() const { return m_Delegate; }
+
+	bool operator == (const weak_delegate &x) const { return m_Ref == x.m_Ref && m_Delegate == x.m_Delegate; }
+	bool operator != (const weak_delegate &x) const { return !(*this == x); }
+
+	// Calls the target if it is alive, a dead one returns a value-initialized
+	// result or throws std::bad_function_call if it can't (see detail::empty_result)
+	template<class... Pf>
+	RetType operator() (Pf&&... params) const
+	{
+		if(m_Ref.alive())
+			return m_Delegate(std::forward<Pf>(params)...);
+		return detail::empty_result<RetType>::get();
+	}
+
+private:
+	static const weak_target& target_of(const weak_target *target) { return *target; }
+
+	weak_ref m_Ref;
+	delegate_type m_Delegate;
+};
+
+template <class X, class Y, class RetType, class... Params>
+weak_delegate<RetType (Params...)> make_weak_delegate(Y* x, RetType (X::*func)(Params... params)) {
+	return weak_delegate<RetType (Params...)>(x, func);
+}
+
+template <class X, class Y, class RetType, class... Params>
+weak_delegate<RetType (Params...)> make_weak_delegate(Y* x, RetType (X::*func)(Params... params) const) {
+	return weak_delegate<RetType (Params...)>(x, func);
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+}
+
+#endif //_SF_DELEGATE_WEAK_H__
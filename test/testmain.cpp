@@ -3,6 +3,21 @@
 #include <boost/test/unit_test.hpp>
 #include "delegate.h"
 #include "delegate_dynamic.h"
+#include "delegate_multicast.h"
+#include "delegate_concurrent.h"
+#include "delegate_owning.h"
+#include "delegate_executor.h"
+#include "delegate_queue.h"
+#include "delegate_coro.h"
+#include "delegate_flat_map.h"
+#include "delegate_registry.h"
+#include "delegate_weak.h"
+#include "delegate_call_stats.h"
+#include "delegate_call_trace.h"
+#include "delegate_symbols.h"
+#include <memory>
+#include <stdexcept>
+#include <string>
 //////////////////////////////////////////////////////////////////////////
 
 using namespace delegates;
@@ -23,6 +38,47 @@ void F1(Test t)
 	BOOST_CHECK_EQUAL(t.payload, 357);
 }
 
+struct Counter
+{
+	int hits;
+	Counter() : hits(0) { }
+	void add(int n) { hits += n; }
+};
+
+int g_static_hits = 0;
+void F2(int n) { g_static_hits += n; }
+
+struct CopyCounter
+{
+	static int copies;
+	static int moves;
+	static void reset() { copies = 0; moves = 0; }
+
+	int value;
+	CopyCounter() : value(7) { }
+	CopyCounter(const CopyCounter& x) : value(x.value) { ++copies; }
+	CopyCounter(CopyCounter&& x) : value(x.value) { ++moves; }
+};
+int CopyCounter::copies = 0;
+int CopyCounter::moves = 0;
+
+int TakeByValue(CopyCounter c) { return c.value; }
+
+struct ByValueTaker
+{
+	int take(CopyCounter c) { return c.value; }
+};
+
+int Sum7(int a, int b, int c, int d, int e, int f, int g) { return a + b + c + d + e + f + g; }
+
+struct Wide
+{
+	int base;
+	Wide() : base(100) { }
+	int sum8(int a, int b, int c, int d, int e, int f, int g, const Test& t) const
+	{ return base + a + b + c + d + e + f + g + t.payload; }
+};
+
 //////////////////////////////////////////////////////////////////////////
 
 BOOST_AUTO_TEST_SUITE( DelegateTestSuite );
@@ -67,4 +123,1496 @@ BOOST_AUTO_TEST_CASE( TestMethodDyn )
 	BOOST_CHECK_EQUAL(ret, 358);
 }
 
+static long MulAdd(int a, const long &b) { return a * 10 + b; }
+
+BOOST_AUTO_TEST_CASE( TestDynamicBatch )
+{
+	Test2 inst;
+	Test t[3];
+	t[2].payload = 10;
+	void* row0[] = { &t[0] };
+	void* row1[] = { &t[1] };
+	void* row2[] = { &t[2] };
+	void** rows[] = { row0, row1, row2 };
+
+	delegate_dynamic<int (Test)> method(&inst, &Test2::do_stuff);
+	const delegate_dynamic_base &dyn = method;
+	int ret[3] = { 0, 0, 0 };
+	dyn.invoke_batch(rows, ret, sizeof(int), 3);
+	BOOST_CHECK_EQUAL(ret[0], 358);
+	BOOST_CHECK_EQUAL(ret[1], 358);
+	BOOST_CHECK_EQUAL(ret[2], 11);
+	dyn.invoke_batch(rows, 0, 0, 3);
+
+	// columns: ints packed, longs inside records
+	struct Rec { long b; long res; };
+	int a[4] = { 1, 2, 3, 4 };
+	Rec recs[4] = { { 5, 0 }, { 6, 0 }, { 7, 0 }, { 8, 0 } };
+	void* bases[] = { a, &recs[0].b };
+	size_t strides[] = { sizeof(int), sizeof(Rec) };
+
+	delegate_dynamic<long (int, const long&)> stat(&MulAdd);
+	const delegate_dynamic_base &dyn2 = stat;
+	dyn2.invoke_batch_columns(bases, strides, &recs[0].res, sizeof(Rec), 4);
+	BOOST_CHECK_EQUAL(recs[0].res, 15);
+	BOOST_CHECK_EQUAL(recs[3].res, 48);
+
+	Counter c;
+	delegate_dynamic<void (int)> add(&c, &Counter::add);
+	const delegate_dynamic_base &dyn3 = add;
+	void* bases3[] = { a };
+	size_t strides3[] = { sizeof(int) };
+	dyn3.invoke_batch_columns(bases3, strides3, 0, 0, 4);
+	BOOST_CHECK_EQUAL(c.hits, 10);
+}
+
+BOOST_AUTO_TEST_CASE( TestSignatureDesc )
+{
+	static_assert(signature_of<long (int, const long&)>::value.arity == 2, "arity");
+	static_assert(signature_of<long (int, const long&)>::value.args[1].is_ref, "reference parameter");
+	static_assert(signature_of<long (int, const long&)>::value.args[1].type_id == signature_of<void (long)>::value.args[0].type_id, "id of the referred type");
+
+	delegate_dynamic<long (int, const long&)> d1(&MulAdd);
+	delegate_dynamic<long (int, const long&)> d2;
+	delegate_dynamic<int (Test)> d3;
+	const delegate_dynamic_base &dyn = d1;
+
+	const signature_desc &sig = dyn.signature();
+	BOOST_CHECK(&sig == &d2.signature());
+	BOOST_CHECK_EQUAL(sig.arity, 2u);
+	BOOST_CHECK_EQUAL(sig.ret.size, sizeof(long));
+	BOOST_CHECK_EQUAL(sig.args[0].size, sizeof(int));
+	BOOST_CHECK_EQUAL(sig.args[0].align, std::alignment_of<int>::value);
+	BOOST_CHECK(!sig.args[0].is_ref && !sig.args[0].is_const);
+	BOOST_CHECK(sig.args[1].is_ref && sig.args[1].is_const);
+	BOOST_CHECK(sig.args[0].type_id != sig.args[1].type_id);
+
+	const signature_desc &sig3 = d3.signature();
+	BOOST_CHECK(sig.hash != sig3.hash);
+	BOOST_CHECK_EQUAL(sig3.args[0].size, sizeof(Test));
+	BOOST_CHECK_EQUAL(signature_of<void ()>::value.ret.size, 0u);
+	BOOST_CHECK_EQUAL(signature_of<void ()>::value.arity, 0u);
+}
+
+struct Named
+{
+	std::string last;
+	size_t set(char tag, const std::string &name, double weight) { last = tag + name; return last.size() + size_t(weight); }
+};
+
+BOOST_AUTO_TEST_CASE( TestArgFrame )
+{
+	typedef size_t sig_type (char, const std::string&, double);
+	typedef frame_layout<sig_type> layout;
+	static_assert(layout::arg<0>::offset == 0, "first argument at the start");
+	static_assert(layout::arg<1>::offset % std::alignment_of<std::string>::value == 0, "aligned string");
+	static_assert(layout::arg<2>::offset == layout::arg<1>::offset + sizeof(std::string), "double right after the string");
+	static_assert(layout::size % layout::align == 0, "size is a multiple of alignment");
+
+	Named obj;
+	delegate_dynamic<sig_type> d(&obj, &Named::set);
+	const delegate_dynamic_base &dyn = d;
+	BOOST_CHECK_EQUAL(dyn.signature().frame_size, layout::size);
+	BOOST_CHECK_EQUAL(dyn.signature().frame_offsets[2], layout::arg<2>::offset);
+
+	size_t ret = 0;
+	{
+		arg_frame<sig_type> f('a', "bc", 2.0);
+		BOOST_CHECK_EQUAL(f.get<1>(), "bc");
+		dyn.invoke_frame(f.data(), &ret);
+	}
+	BOOST_CHECK_EQUAL(ret, 5u);
+	BOOST_CHECK_EQUAL(obj.last, "abc");
+
+	// frame in a foreign buffer, written by a deserializer
+	std::aligned_storage<layout::size, layout::align>::type buf;
+	*layout::at<0>(&buf) = 'x';
+	layout::construct<1>(&buf, 3, 'y');
+	*layout::at<2>(&buf) = 0.5;
+	dyn.invoke_frame(&buf, 0);
+	BOOST_CHECK_EQUAL(obj.last, "xyyy");
+	layout::destroy_all(&buf);
+}
+
+struct CopyThrower
+{
+	static int live;
+	bool fail;
+	explicit CopyThrower(bool f) : fail(f) { ++live; }
+	CopyThrower(const CopyThrower &x) : fail(x.fail) { if(fail) throw std::runtime_error("copy failed"); ++live; }
+	~CopyThrower() { --live; }
+};
+int CopyThrower::live = 0;
+
+BOOST_AUTO_TEST_CASE( TestArgFrameThrow )
+{
+	// arguments built before the throwing one are destroyed
+	std::shared_ptr<int> token(new int(1));
+	CopyThrower ok(false), bad(true);
+	typedef arg_frame<void (std::shared_ptr<int>, CopyThrower, const CopyThrower&)> frame_type;
+	BOOST_CHECK_THROW(frame_type f(token, ok, bad), std::runtime_error);
+	BOOST_CHECK_EQUAL(token.use_count(), 1);
+	BOOST_CHECK_EQUAL(CopyThrower::live, 2);
+}
+
+struct NoDefault
+{
+	std::string text;
+	explicit NoDefault(const std::string &t) : text(t) { }
+};
+
+NoDefault MakeNoDefault(std::string a, const std::string &b) { return NoDefault(a + b); }
+
+BOOST_AUTO_TEST_CASE( TestDynamicMoveConstruct )
+{
+	delegate_dynamic<int (CopyCounter)> d(&TakeByValue);
+	const delegate_dynamic_base &dyn = d;
+	CopyCounter c;
+	void* args[] = { &c };
+	int ret = 0;
+
+	CopyCounter::reset();
+	dyn.invoke(args, &ret);
+	BOOST_CHECK_EQUAL(CopyCounter::copies, 1);
+
+	CopyCounter::reset();
+	dyn.invoke_move(args, &ret);
+	BOOST_CHECK_EQUAL(CopyCounter::copies, 0);
+	BOOST_CHECK_EQUAL(ret, 7);
+
+	delegate_dynamic<NoDefault (std::string, const std::string&)> make(&MakeNoDefault);
+	const delegate_dynamic_base &dyn2 = make;
+	std::string a(40, 'a'), b("b");
+	void* args2[] = { &a, &b };
+	std::aligned_storage<sizeof(NoDefault), std::alignment_of<NoDefault>::value>::type storage;
+	dyn2.invoke_ex(args2, &storage, invoke_move_args | invoke_construct_ret);
+	NoDefault &res = *reinterpret_cast<NoDefault*>(&storage);
+	BOOST_CHECK_EQUAL(res.text.size(), 41u);
+	BOOST_CHECK_EQUAL(b, "b");
+	res.~NoDefault();
+}
+
+BOOST_AUTO_TEST_CASE( TestDelegateAny )
+{
+	static_assert(std::is_trivially_copyable<delegate_any>::value, "delegate_any must be trivially copyable");
+
+	Test2 inst;
+	Test t;
+	delegate_any handles[] = {
+		delegate_any(&inst, &Test2::do_stuff),
+		delegate_any(make_delegate_dynamic(&inst, &Test2::do_stuff)),
+		delegate_any(&F1) };
+	BOOST_CHECK(handles[0] == handles[1]);
+	BOOST_CHECK(handles[0] != handles[2]);
+
+	void* args[] = { &t };
+	for(int i = 0; i != 2; ++i)
+	{
+		delegate_any copy = handles[i];
+		int ret = 0;
+		copy.invoke(args, &ret);
+		BOOST_CHECK_EQUAL(ret, 358);
+	}
+	handles[2].invoke(args, 0);
+
+	BOOST_CHECK(!delegate_any());
+	handles[0].clear();
+	BOOST_CHECK(handles[0].empty());
+}
+
+BOOST_AUTO_TEST_CASE( TestStaticFuncNoExtraCopy )
+{
+	ByValueTaker inst;
+	auto sdeleg = make_delegate(&TakeByValue);
+	auto mdeleg = make_delegate(&inst, &ByValueTaker::take);
+	CopyCounter c;
+
+	// lvalue: one copy into the parameter, same as a direct call
+	CopyCounter::reset();
+	BOOST_CHECK_EQUAL(mdeleg(c), 7);
+	int method_copies = CopyCounter::copies, method_moves = CopyCounter::moves;
+	BOOST_CHECK_EQUAL(method_copies, 1);
+
+	CopyCounter::reset();
+	BOOST_CHECK_EQUAL(sdeleg(c), 7);
+	BOOST_CHECK_EQUAL(CopyCounter::copies, method_copies);
+#if defined(FASTDLGT_ITANIUM_ABI)
+	BOOST_CHECK_EQUAL(CopyCounter::moves, method_moves);
+#else
+	BOOST_CHECK(CopyCounter::moves <= method_moves + 1);
+#endif
+
+	// rvalue: moved into the parameter, never copied
+	CopyCounter::reset();
+	mdeleg(CopyCounter());
+	method_moves = CopyCounter::moves;
+	BOOST_CHECK_EQUAL(CopyCounter::copies, 0);
+
+	CopyCounter::reset();
+	sdeleg(CopyCounter());
+	BOOST_CHECK_EQUAL(CopyCounter::copies, 0);
+#if defined(FASTDLGT_ITANIUM_ABI)
+	BOOST_CHECK_EQUAL(CopyCounter::moves, method_moves);
+#endif
+}
+
+BOOST_AUTO_TEST_CASE( TestNumberedAliases )
+{
+	delegate1<Test> d1 = make_delegate(&F1);
+	delegate<void (Test)> d2 = d1;
+	BOOST_CHECK(d1 == d2);
+
+	Test2 inst;
+	delegate_dynamic1<Test, int> dyn(&inst, &Test2::do_stuff);
+	BOOST_CHECK_EQUAL(dyn(Test()), 358);
+}
+
+BOOST_AUTO_TEST_CASE( TestManyArgs )
+{
+	auto sdeleg = make_delegate(&Sum7);
+	BOOST_CHECK_EQUAL(sdeleg(1, 2, 3, 4, 5, 6, 7), 28);
+
+	Wide w;
+	auto mdeleg = make_delegate(&w, &Wide::sum8);
+	BOOST_CHECK_EQUAL(mdeleg(1, 2, 3, 4, 5, 6, 7, Test()), 485);
+
+	auto ddeleg = make_delegate_dynamic(&w, &Wide::sum8);
+	int a[7] = { 1, 2, 3, 4, 5, 6, 7 };
+	Test t;
+	void* args[] = { &a[0], &a[1], &a[2], &a[3], &a[4], &a[5], &a[6], &t };
+	int ret = 0;
+	ddeleg.invoke(args, &ret);
+	BOOST_CHECK_EQUAL(ret, 485);
+
+	delegate_dynamic_base* base = &ddeleg;
+	ret = 0;
+	base->invoke(args, &ret);
+	BOOST_CHECK_EQUAL(ret, 485);
+}
+
+struct MoveOnlyAdder
+{
+	std::unique_ptr<int> p;
+	int operator() (int v) const { return *p + v; }
+};
+
+BOOST_AUTO_TEST_CASE( TestOwningLambda )
+{
+	int base = 5;
+	owning_delegate<int (int)> d = [base](int v) { return base + v; };
+	BOOST_CHECK(d.owns_callable());
+	BOOST_CHECK_EQUAL(d(2), 7);
+
+	// move-only capture, stays inline
+	MoveOnlyAdder adder;
+	adder.p.reset(new int(40));
+	BOOST_CHECK(owning_delegate<int (int)>::fits_inline<MoveOnlyAdder>::value);
+	owning_delegate<int (int)> m(std::move(adder));
+	owning_delegate<int (int)> moved(std::move(m));
+	BOOST_CHECK(!m);
+	BOOST_CHECK_EQUAL(moved(2), 42);
+
+	// capture bigger than the buffer goes to the heap
+	char big[100] = { 3 };
+	auto big_lambda = [big](int v) { return big[0] + v; };
+	BOOST_CHECK(!(owning_delegate<int (int), 32>::fits_inline<decltype(big_lambda)>::value));
+	owning_delegate<int (int), 32> h(big_lambda);
+	owning_delegate<int (int), 32> h2(std::move(h));
+	BOOST_CHECK_EQUAL(h2(1), 4);
+
+	// plain delegates are stored without ownership
+	Test2 inst;
+	owning_delegate<int (Test)> f(&inst, &Test2::do_stuff);
+	BOOST_CHECK(!f.owns_callable());
+	BOOST_CHECK_EQUAL(f(Test()), 358);
+}
+
+BOOST_AUTO_TEST_CASE( TestOwningDestroys )
+{
+	std::shared_ptr<int> token(new int(1));
+	{
+		owning_delegate<int ()> d = [token]() { return *token; };
+		BOOST_CHECK_EQUAL(token.use_count(), 2);
+		owning_delegate<int ()> d2;
+		d2 = std::move(d);
+		BOOST_CHECK_EQUAL(token.use_count(), 2);
+		BOOST_CHECK_EQUAL(d2(), 1);
+		d2.clear();
+		BOOST_CHECK_EQUAL(token.use_count(), 1);
+		d2 = [token]() { return *token + 1; };
+		BOOST_CHECK_EQUAL(d2(), 2);
+	}
+	BOOST_CHECK_EQUAL(token.use_count(), 1);
+}
+
+BOOST_AUTO_TEST_CASE( TestOwningByValue )
+{
+	owning_delegate<int (CopyCounter)> d = [](CopyCounter c) { return c.value; };
+	CopyCounter arg;
+	arg.value = 3;
+	CopyCounter::reset();
+	BOOST_CHECK_EQUAL(d(arg), 3);
+	// only the copy made for the call, the holder moves it into the lambda
+	BOOST_CHECK_EQUAL(CopyCounter::copies, 1);
+	CopyCounter::reset();
+	BOOST_CHECK_EQUAL(d(std::move(arg)), 3);
+	BOOST_CHECK_EQUAL(CopyCounter::copies, 0);
+}
+
+BOOST_AUTO_TEST_CASE( TestMulticast )
+{
+	Counter c1, c2;
+	multicast_delegate<void (int)> ev;
+	BOOST_CHECK(ev.empty());
+
+	ev += &F2;
+	ev += make_delegate(&c1, &Counter::add);
+	ev += make_delegate(&c2, &Counter::add);
+	BOOST_CHECK_EQUAL(ev.size(), 3u);
+
+	g_static_hits = 0;
+	ev(2);
+	BOOST_CHECK_EQUAL(g_static_hits, 2);
+	BOOST_CHECK_EQUAL(c1.hits, 2);
+	BOOST_CHECK_EQUAL(c2.hits, 2);
+
+	ev -= make_delegate(&c1, &Counter::add);
+	BOOST_CHECK(!ev.contains(make_delegate(&c1, &Counter::add)));
+	ev(3);
+	BOOST_CHECK_EQUAL(g_static_hits, 5);
+	BOOST_CHECK_EQUAL(c1.hits, 2);
+	BOOST_CHECK_EQUAL(c2.hits, 5);
+}
+
+BOOST_AUTO_TEST_CASE( TestMulticastGrowth )
+{
+	std::vector<Counter> counters(100);
+	event<void (int)> ev;
+	for(size_t i = 0; i != counters.size(); ++i)
+	{
+		ev += make_delegate(&counters[i], &Counter::add);
+		ev += &F2;
+	}
+
+	g_static_hits = 0;
+	ev(1);
+	BOOST_CHECK_EQUAL(g_static_hits, 100);
+	for(size_t i = 0; i != counters.size(); ++i)
+		BOOST_CHECK_EQUAL(counters[i].hits, 1);
+
+	event<void (int)> copy(ev);
+	copy(1);
+	BOOST_CHECK_EQUAL(g_static_hits, 200);
+}
+
+struct SelfRemover
+{
+	concurrent_event<void (int)>* ev;
+	int hits;
+	SelfRemover() : ev(0), hits(0) { }
+	void handle(int) { ++hits; ev->remove(make_delegate(this, &SelfRemover::handle)); }
+};
+
+BOOST_AUTO_TEST_CASE( TestConcurrentMulticast )
+{
+	Counter c1;
+	SelfRemover once;
+	concurrent_event<void (int)> ev;
+	once.ev = &ev;
+
+	ev += &F2;
+	ev += make_delegate(&c1, &Counter::add);
+	ev += make_delegate(&once, &SelfRemover::handle);
+	BOOST_CHECK_EQUAL(ev.size(), 3u);
+
+	g_static_hits = 0;
+	ev(2);
+	ev(2);
+	BOOST_CHECK_EQUAL(g_static_hits, 4);
+	BOOST_CHECK_EQUAL(c1.hits, 4);
+	BOOST_CHECK_EQUAL(once.hits, 1);
+	BOOST_CHECK_EQUAL(ev.size(), 2u);
+
+	ev.clear();
+	ev(2);
+	BOOST_CHECK(ev.empty());
+	BOOST_CHECK_EQUAL(c1.hits, 4);
+}
+
+struct AtomicCounter
+{
+	std::atomic<int> hits;
+	AtomicCounter() : hits(0) { }
+	void add(int n) { hits += n; }
+};
+
+BOOST_AUTO_TEST_CASE( TestConcurrentMulticastThreads )
+{
+	concurrent_multicast_delegate<void (int)> ev;
+	std::vector<AtomicCounter> counters(16);
+	std::atomic<bool> done(false);
+	ev += make_delegate(&counters[0], &AtomicCounter::add);
+
+	std::thread writer([&] {
+		for(int round = 0; round != 200; ++round)
+			for(size_t i = 1; i != counters.size(); ++i)
+			{
+				ev += make_delegate(&counters[i], &AtomicCounter::add);
+				ev -= make_delegate(&counters[i], &AtomicCounter::add);
+			}
+		done = true;
+	});
+
+	std::vector<int> fired(4);
+	std::vector<std::thread> readers;
+	for(size_t t = 0; t != fired.size(); ++t)
+		readers.push_back(std::thread([&, t] {
+			while(!done) { ev(1); ++fired[t]; }
+		}));
+
+	writer.join();
+	for(size_t t = 0; t != readers.size(); ++t)
+		readers[t].join();
+
+	BOOST_CHECK_EQUAL(ev.size(), 1u);
+	BOOST_CHECK(ev.contains(make_delegate(&counters[0], &AtomicCounter::add)));
+	int total = 0;
+	for(size_t t = 0; t != fired.size(); ++t)
+		total += fired[t];
+	BOOST_CHECK_EQUAL(counters[0].hits, total);
+}
+
+BOOST_AUTO_TEST_CASE( TestConcurrentReaderStripes )
+{
+	// One stripe per hardware thread by default, a power of 2
+	concurrent_multicast_delegate<void (int)> ev;
+	size_t stripes = ev.reader_stripes();
+	BOOST_CHECK(stripes >= std::thread::hardware_concurrency());
+	BOOST_CHECK_EQUAL(stripes & (stripes - 1), 0u);
+
+	concurrent_multicast_delegate<void (int), 5> fixed;
+	BOOST_CHECK_EQUAL(fixed.reader_stripes(), 8u);
+	AtomicCounter c;
+	fixed += make_delegate(&c, &AtomicCounter::add);
+	fixed(2);
+	fixed -= make_delegate(&c, &AtomicCounter::add);
+	BOOST_CHECK_EQUAL(c.hits, 2);
+}
+
+struct Overloaded
+{
+	int last;
+	Overloaded() : last(0) { }
+	void operator() (int v) { last = v; }
+	void operator() (const char*) { last = -1; }
+};
+
+static int Twice(int v) { return v * 2; }
+
+static int call_with_ref(delegate_ref<int (int)> fn, int v) { return fn(v); }
+
+BOOST_AUTO_TEST_CASE( TestFunctorRef )
+{
+	int sum = 0;
+	auto add = [&sum](int v) { sum += v; };
+	delegate<void (int)> d(add);
+	d(3);
+	d(4);
+	BOOST_CHECK_EQUAL(sum, 7);
+	BOOST_CHECK(d == delegate<void (int)>(add));
+
+	// signature differs from operator(), called through a thunk
+	delegate<void (short)> conv(add);
+	conv(5);
+	BOOST_CHECK_EQUAL(sum, 12);
+
+	auto generic = [](int a, int b) { return a * b; };
+	delegate<long (int, long)> mul(generic);
+	BOOST_CHECK_EQUAL(mul(6, 7), 42);
+
+	auto deduced = make_delegate(add);
+	deduced(1);
+	BOOST_CHECK_EQUAL(sum, 13);
+
+	Overloaded o;
+	delegate<void (int)> by_int(o);
+	delegate<void (const char*)> by_str(o);
+	by_int(9);
+	BOOST_CHECK_EQUAL(o.last, 9);
+	by_str("x");
+	BOOST_CHECK_EQUAL(o.last, -1);
+
+	int base = 100;
+	BOOST_CHECK_EQUAL(call_with_ref([base](int v) { return base + v; }, 1), 101);
+	BOOST_CHECK_EQUAL(call_with_ref(&Twice, 5), 10);
+
+	// by-value argument through the thunk, no copy besides the call's own
+	auto value_of = [](CopyCounter c) -> long { return c.value; };
+	delegate<int (CopyCounter)> by_value(value_of);
+	CopyCounter arg;
+	CopyCounter::reset();
+	BOOST_CHECK_EQUAL(by_value(arg), 7);
+	BOOST_CHECK_EQUAL(CopyCounter::copies, 1);
+	CopyCounter::reset();
+	BOOST_CHECK_EQUAL(by_value(CopyCounter()), 7);
+	BOOST_CHECK_EQUAL(CopyCounter::copies, 0);
+}
+
+struct Gate
+{
+	std::atomic<bool> open;
+	Gate() : open(false) { }
+	int pass(int v) { while(!open) std::this_thread::yield(); return v; }
+};
+
+struct Thrower
+{
+	int fail(int) { throw std::runtime_error("failed"); }
+};
+
+struct Spawner
+{
+	delegate_executor *pool;
+	std::atomic<int> leaves;
+	Spawner() : leaves(0) { }
+
+	// Splits into two subtasks, submitted from the worker thread
+	void split(int depth)
+	{
+		if(depth == 0) { ++leaves; return; }
+		delegate<void (int)> self(this, &Spawner::split);
+		pool->submit(self, depth - 1);
+		pool->submit(self, depth - 1);
+	}
+};
+
+BOOST_AUTO_TEST_CASE( TestExecutor )
+{
+	delegate_executor pool(4);
+	BOOST_CHECK_EQUAL(pool.size(), 4u);
+
+	Named obj;
+	task_future<int> f1 = pool.submit(make_delegate(&Sum7), 1, 2, 3, 4, 5, 6, 7);
+	task_future<size_t> f2 = pool.submit(make_delegate(&obj, &Named::set), 'n', std::string("ame"), 1.0);
+	Thrower thrower;
+	task_future<int> f3 = pool.submit(make_delegate(&thrower, &Thrower::fail), 1);
+	BOOST_CHECK_EQUAL(f1.get(), 28);
+	BOOST_CHECK_EQUAL(f2.get(), 5u);
+	BOOST_CHECK_EQUAL(obj.last, "name");
+	BOOST_CHECK_THROW(f3.get(), std::runtime_error);
+
+	Spawner sp;
+	sp.pool = &pool;
+	pool.submit(delegate<void (int)>(&sp, &Spawner::split), 10);
+	pool.wait_idle();
+	BOOST_CHECK_EQUAL(sp.leaves.load(), 1024);
+}
+
+BOOST_AUTO_TEST_CASE( TestExecutorCancel )
+{
+	delegate_executor pool(1);
+	Gate gate;
+	task_future<int> blocked = pool.submit(make_delegate(&gate, &Gate::pass), 1);
+	task_future<int> queued = pool.submit(make_delegate(&gate, &Gate::pass), 2);
+
+	BOOST_CHECK(queued.cancel());
+	BOOST_CHECK(queued.cancelled());
+	BOOST_CHECK(queued.ready());
+	gate.open = true;
+
+	BOOST_CHECK_EQUAL(blocked.get(), 1);
+	BOOST_CHECK(!blocked.cancel());
+	BOOST_CHECK_THROW(queued.get(), task_cancelled);
+}
+
+struct Fanout
+{
+	delegate_executor *pool;
+	std::atomic<int> leaves;
+	Fanout() : leaves(0) { }
+	void spread(int n)
+	{
+		for(int i = 0; i != n; ++i)
+			pool->submit(delegate<void (int)>(this, &Fanout::leaf), i);
+	}
+	void leaf(int) { ++leaves; }
+};
+
+BOOST_AUTO_TEST_CASE( TestExecutorContention )
+{
+	delegate_executor pool(4);
+
+	// one worker pushes more tasks than its deque holds at first, the others steal
+	Fanout fan;
+	fan.pool = &pool;
+	pool.submit(delegate<void (int)>(&fan, &Fanout::spread), 1000);
+	pool.wait_idle();
+	BOOST_CHECK_EQUAL(fan.leaves.load(), 1000);
+
+	// submitted from several threads at once, waited for from others
+	std::vector< task_future<int> > futures[4];
+	std::vector<std::thread> threads;
+	for(int t = 0; t != 4; ++t)
+		threads.push_back(std::thread([&pool, &futures, t] {
+			for(int i = 0; i != 1000; ++i)
+				futures[t].push_back(pool.submit(make_delegate(&Twice), i));
+		}));
+	for(size_t t = 0; t != threads.size(); ++t)
+		threads[t].join();
+	threads.clear();
+
+	std::atomic<int> sum(0);
+	for(int t = 0; t != 4; ++t)
+		threads.push_back(std::thread([&futures, &sum, t] {
+			for(size_t i = 0; i != futures[t].size(); ++i)
+				sum += futures[t][i].get();
+		}));
+	for(size_t t = 0; t != threads.size(); ++t)
+		threads[t].join();
+	BOOST_CHECK_EQUAL(sum.load(), 4 * 999 * 1000);
+}
+
+struct OrderChecker
+{
+	std::vector<int> last;
+	int calls;
+	bool in_order;
+	OrderChecker(size_t producers) : last(producers, -1), calls(0), in_order(true) { }
+	void on_call(int producer, int seq)
+	{
+		in_order = in_order && seq == last[producer] + 1;
+		last[producer] = seq;
+		++calls;
+	}
+};
+
+void AppendTo(std::vector<std::string> *out, std::string s) { out->push_back(std::move(s)); }
+
+BOOST_AUTO_TEST_CASE( TestCallQueue )
+{
+	std::vector<std::string> out;
+	call_queue<> q(4);
+	BOOST_CHECK_EQUAL(q.capacity(), 4u);
+	BOOST_CHECK(q.empty());
+	q.post(make_delegate(&AppendTo), &out, std::string("a"));
+	q.post(make_delegate(&AppendTo), &out, "b");
+	BOOST_CHECK(!q.empty());
+	BOOST_CHECK(out.empty());
+	BOOST_CHECK_EQUAL(q.drain(), 2u);
+	BOOST_CHECK_EQUAL(out.size(), 2u);
+	BOOST_CHECK_EQUAL(out[1], "b");
+
+	OrderChecker checker(1);
+	call_queue<> drop(2, queue_full_drop);
+	delegate<void (int, int)> d(&checker, &OrderChecker::on_call);
+	BOOST_CHECK(drop.post(d, 0, 0));
+	BOOST_CHECK(drop.post(d, 0, 1));
+	BOOST_CHECK(!drop.post(d, 0, 2));
+	BOOST_CHECK_EQUAL(drop.drain(1), 1u);
+	BOOST_CHECK(drop.post(d, 0, 2));
+	BOOST_CHECK_EQUAL(drop.drain(), 2u);
+
+	call_queue<> grow(2, queue_full_grow);
+	for(int i = 3; i != 10; ++i)
+		BOOST_CHECK(grow.post(d, 0, i));
+	BOOST_CHECK_EQUAL(grow.drain(), 7u);
+	BOOST_CHECK(checker.in_order);
+	BOOST_CHECK_EQUAL(checker.calls, 10);
+
+	// destroyed without running, arguments are released
+	std::shared_ptr<int> owned(new int(1));
+	{
+		call_queue<> pending;
+		pending.post(delegate<void (std::shared_ptr<int>)>(), owned);
+		BOOST_CHECK_EQUAL(owned.use_count(), 2);
+	}
+	BOOST_CHECK_EQUAL(owned.use_count(), 1);
+}
+
+void HoldOrThrow(std::shared_ptr<int>, bool fail) { if(fail) throw std::runtime_error("failed"); }
+
+BOOST_AUTO_TEST_CASE( TestCallQueueThrow )
+{
+	std::shared_ptr<int> owned(new int(1));
+	delegate<void (std::shared_ptr<int>, bool)> d(&HoldOrThrow);
+
+	// the throwing call's slot and arguments are released, the queue stays usable
+	call_queue<> drop(2, queue_full_drop);
+	BOOST_CHECK(drop.post(d, owned, true));
+	BOOST_CHECK(drop.post(d, owned, false));
+	BOOST_CHECK_THROW(drop.drain(), std::runtime_error);
+	BOOST_CHECK_EQUAL(owned.use_count(), 2);
+	BOOST_CHECK(drop.post(d, owned, false));
+	BOOST_CHECK_EQUAL(drop.drain(), 2u);
+	BOOST_CHECK_EQUAL(owned.use_count(), 1);
+	BOOST_CHECK(drop.empty());
+
+	// overflow calls behind the throwing one run with the next drain
+	call_queue<> grow(2, queue_full_grow);
+	for(int i = 0; i != 5; ++i)
+		BOOST_CHECK(grow.post(d, owned, i == 3));
+	BOOST_CHECK_THROW(grow.drain(), std::runtime_error);
+	BOOST_CHECK_EQUAL(owned.use_count(), 2);
+	BOOST_CHECK_EQUAL(grow.drain(), 1u);
+	BOOST_CHECK_EQUAL(owned.use_count(), 1);
+	BOOST_CHECK(grow.empty());
+
+	// an argument failing to copy: nothing is queued, the slot is skipped
+	std::vector<std::string> out;
+	CopyThrower bad(true);
+	delegate<void (std::shared_ptr<int>, CopyThrower)> take;
+	BOOST_CHECK_THROW(drop.post(take, owned, bad), std::runtime_error);
+	BOOST_CHECK(drop.post(make_delegate(&AppendTo), &out, "a"));
+	BOOST_CHECK_EQUAL(drop.drain(), 1u);
+	BOOST_CHECK_EQUAL(out.size(), 1u);
+	BOOST_CHECK_EQUAL(owned.use_count(), 1);
+
+	// also when it would have gone to the overflow list
+	BOOST_CHECK(grow.post(d, owned, false));
+	BOOST_CHECK(grow.post(d, owned, false));
+	BOOST_CHECK_THROW(grow.post(take, owned, bad), std::runtime_error);
+	BOOST_CHECK_EQUAL(owned.use_count(), 3);
+	BOOST_CHECK_EQUAL(grow.drain(), 2u);
+	BOOST_CHECK_EQUAL(owned.use_count(), 1);
+	BOOST_CHECK(grow.empty());
+}
+
+// Copying it stalls the producer between claiming a slot and publishing it
+struct StallingArg
+{
+	std::atomic<bool> *copying, *resume;
+	StallingArg(std::atomic<bool> *c, std::atomic<bool> *r) : copying(c), resume(r) { }
+	StallingArg(const StallingArg &x) : copying(x.copying), resume(x.resume)
+	{
+		*copying = true;
+		while(!*resume)
+			std::this_thread::yield();
+	}
+};
+
+void RecordStalled(std::vector<int> *out, StallingArg) { out->push_back(0); }
+void RecordValue(std::vector<int> *out, int v) { out->push_back(v); }
+
+BOOST_AUTO_TEST_CASE( TestCallQueueOverflowOrder )
+{
+	std::vector<int> out;
+	call_queue<> q(2, queue_full_grow);
+	delegate<void (std::vector<int>*, int)> record(&RecordValue);
+
+	// drain(n) runs at most n calls, from the overflow list too
+	for(int i = 1; i != 6; ++i)
+		q.post(record, &out, i);
+	BOOST_CHECK_EQUAL(q.drain(1), 1u);
+	BOOST_CHECK_EQUAL(q.drain(2), 2u);
+	BOOST_CHECK_EQUAL(out.size(), 3u);
+	BOOST_CHECK_EQUAL(q.drain(), 2u);
+	BOOST_CHECK_EQUAL(out.size(), 5u);
+	BOOST_CHECK_EQUAL(out[4], 5);
+
+	// overflow calls wait for a slot still being written before them
+	out.clear();
+	std::atomic<bool> copying(false), resume(false);
+	StallingArg stalling(&copying, &resume);
+	std::thread producer([&] { q.post(make_delegate(&RecordStalled), &out, stalling); });
+	while(!copying)
+		std::this_thread::yield();
+	q.post(record, &out, 1);	// the last ring slot
+	q.post(record, &out, 2);	// overflow
+	BOOST_CHECK_EQUAL(q.drain(), 0u);
+	resume = true;
+	producer.join();
+	BOOST_CHECK_EQUAL(q.drain(), 3u);
+	BOOST_CHECK_EQUAL(out.size(), 3u);
+	BOOST_CHECK(out == std::vector<int>({ 0, 1, 2 }));
+}
+
+BOOST_AUTO_TEST_CASE( TestCallQueueThreads )
+{
+	const int producers = 4, per_producer = 20000;
+	OrderChecker checker(producers);
+	delegate<void (int, int)> d(&checker, &OrderChecker::on_call);
+	call_queue<> q(64);
+
+	std::vector<std::thread> threads;
+	for(int p = 0; p != producers; ++p)
+		threads.push_back(std::thread([&, p] {
+			for(int i = 0; i != per_producer; ++i)
+			{
+				q.post(d, p, i);
+				// may be asked on any thread
+				(void)q.empty();
+			}
+		}));
+
+	while(checker.calls != producers * per_producer)
+		if(!q.drain(16))
+			std::this_thread::yield();
+
+	for(size_t t = 0; t != threads.size(); ++t)
+		threads[t].join();
+	BOOST_CHECK(checker.in_order);
+	BOOST_CHECK(q.empty());
+}
+
+#if __cplusplus >= 202002L
+
+// Coroutine which starts eagerly and isn't awaited by anyone
+struct detached_task
+{
+	struct promise_type
+	{
+		detached_task get_return_object() { return detached_task(); }
+		std::suspend_never initial_suspend() { return std::suspend_never(); }
+		std::suspend_never final_suspend() noexcept { return std::suspend_never(); }
+		void return_void() { }
+		void unhandled_exception() { std::terminate(); }
+	};
+};
+
+typedef event< void (int, const std::string&) > named_event;
+
+detached_task CollectEvents(awaitable_event<named_event> &source, std::vector<std::string> &out, int count)
+{
+	for(int i = 0; i != count; ++i)
+	{
+		auto [id, name] = co_await source.next();
+		out.push_back(name + char('0' + id));
+	}
+}
+
+detached_task SumAsync(delegate_executor &pool, std::atomic<int> &result)
+{
+	int sum = co_await async_call(pool, make_delegate(&Sum7), 1, 2, 3, 4, 5, 6, 7);
+	result = sum;
+}
+
+BOOST_AUTO_TEST_CASE( TestAwaitEvent )
+{
+	named_event ev;
+	std::vector<std::string> out;
+	{
+		awaitable_event<named_event> source(ev);
+		BOOST_CHECK_EQUAL(ev.size(), 1u);
+		BOOST_CHECK(!source.waiting());
+
+		CollectEvents(source, out, 2);
+		BOOST_CHECK(source.waiting());
+		ev(1, "a");
+		BOOST_CHECK_EQUAL(out.size(), 1u);
+		ev(2, "b");
+		BOOST_CHECK(!source.waiting());
+		ev(3, "c");
+	}
+	BOOST_CHECK(ev.empty());
+	BOOST_CHECK_EQUAL(out.size(), 2u);
+	BOOST_CHECK_EQUAL(out[1], "b2");
+}
+
+BOOST_AUTO_TEST_CASE( TestAwaitAsyncCall )
+{
+	delegate_executor pool(2);
+	std::atomic<int> result(0);
+	SumAsync(pool, result);
+	pool.wait_idle();
+	while(result == 0)
+		std::this_thread::yield();
+	BOOST_CHECK_EQUAL(result.load(), 28);
+}
+
+#endif
+
+BOOST_AUTO_TEST_CASE( TestDelegateHash )
+{
+	Counter c1, c2;
+	delegate<void (int)> a(&c1, &Counter::add), b(&c2, &Counter::add);
+	std::hash< delegate<void (int)> > h;
+	BOOST_CHECK_EQUAL(h(a), h(delegate<void (int)>(&c1, &Counter::add)));
+	BOOST_CHECK(h(a) != h(b));
+
+	// copies of static function delegates hash alike in both closure modes
+	delegate<void (Test)> f(&F1);
+	std::vector< delegate<void (Test)> > copies(3, f);
+	BOOST_CHECK(copies[2] == f);
+	BOOST_CHECK_EQUAL(std::hash< delegate<void (Test)> >()(copies[2]), std::hash< delegate<void (Test)> >()(f));
+	BOOST_CHECK_EQUAL(std::hash<detail::function_data>()(f.getFunctionData()), f.getFunctionData().GetHash());
+
+	delegate_any any(a);
+	BOOST_CHECK_EQUAL(std::hash<delegate_any>()(any), h(a));
+}
+
+BOOST_AUTO_TEST_CASE( TestDelegateHashMap )
+{
+	std::vector<Counter> counters(100);
+	delegate_hash_set< delegate<void (int)> > set;
+	BOOST_CHECK(set.empty());
+	BOOST_CHECK(set.insert(make_delegate(&counters[0], &Counter::add)));
+	BOOST_CHECK(!set.insert(make_delegate(&counters[0], &Counter::add)));
+	BOOST_CHECK(set.contains(make_delegate(&counters[0], &Counter::add)));
+	BOOST_CHECK(!set.contains(make_delegate(&counters[1], &Counter::add)));
+
+	delegate_hash_map< delegate<void (int)>, int > map;
+	for(int i = 0; i != 100; ++i)
+		map[make_delegate(&counters[i], &Counter::add)] = i;
+	BOOST_CHECK_EQUAL(map.size(), 100u);
+	BOOST_CHECK(!map.insert(make_delegate(&counters[5], &Counter::add), -1));
+	BOOST_CHECK_EQUAL(*map.find(make_delegate(&counters[5], &Counter::add)), 5);
+
+	// erasing shifts the rest of the probe sequence, everything else stays reachable
+	for(int i = 0; i < 100; i += 2)
+		BOOST_CHECK(map.erase(make_delegate(&counters[i], &Counter::add)));
+	BOOST_CHECK(!map.erase(make_delegate(&counters[0], &Counter::add)));
+	BOOST_CHECK_EQUAL(map.size(), 50u);
+	bool found = true;
+	for(int i = 0; i != 100; ++i)
+	{
+		const int *v = map.find(make_delegate(&counters[i], &Counter::add));
+		found = found && (i % 2 ? v && *v == i : v == 0);
+	}
+	BOOST_CHECK(found);
+
+	int sum = 0;
+	map.for_each([&sum](const delegate<void (int)> &d, int v) { d(1); sum += v; });
+	BOOST_CHECK_EQUAL(sum, 2500);
+	BOOST_CHECK_EQUAL(counters[1].hits, 1);
+	BOOST_CHECK_EQUAL(counters[2].hits, 0);
+
+	delegate_hash_map< delegate<void (Test)>, std::string > statics;
+	statics[make_delegate(&F1)] = "F1";
+	delegate_hash_map< delegate<void (Test)>, std::string > copy(statics);
+	statics.clear();
+	BOOST_CHECK(statics.find(make_delegate(&F1)) == 0);
+	BOOST_CHECK_EQUAL(*copy.find(make_delegate(&F1)), "F1");
+}
+
+struct IdentityHash
+{
+	size_t operator() (int v) const { return size_t(v); }
+};
+
+BOOST_AUTO_TEST_CASE( TestDelegateHashMapSpread )
+{
+	// every key lands in its own home slot, so they are visited in slot order
+	detail::flat_table<int, detail::flat_no_value, IdentityHash, std::equal_to<int> > table;
+	table.reserve(6);
+	BOOST_CHECK_EQUAL(table.capacity(), 8u);
+	const int keys[] = { 5, 3, 0, 4, 1, 2 };
+	for(size_t i = 0; i != 6; ++i)
+		BOOST_CHECK(table.emplace(keys[i]).second);
+	std::vector<int> order;
+	table.for_each_entry([&order](const std::pair<int, detail::flat_no_value> &v) { order.push_back(v.first); });
+	BOOST_CHECK_EQUAL(order.size(), 6u);
+	for(size_t i = 0; i != order.size(); ++i)
+		BOOST_CHECK_EQUAL(order[i], int(i));
+}
+
+BOOST_AUTO_TEST_CASE( TestMethodRegistry )
+{
+	Named obj;
+	delegate_dynamic<size_t (char, const std::string&, double)> set(&obj, &Named::set);
+	delegate_dynamic<long (int, const long&)> muladd(&MulAdd);
+
+	method_registry methods;
+	BOOST_CHECK(methods.find("suffix") == 0);
+	BOOST_CHECK(methods.add("set", &set));
+	BOOST_CHECK(methods.add("muladd", &muladd));
+	BOOST_CHECK(!methods.add("muladd", &muladd));
+	BOOST_CHECK(methods.find("muladd") == 0);
+	methods.build();
+	BOOST_CHECK_EQUAL(methods.size(), 2u);
+	BOOST_CHECK(methods.find("muladd") == &muladd);
+	BOOST_CHECK(methods.find(std::string("set")) == &set);
+	BOOST_CHECK(methods.find("mula") == 0);
+	BOOST_CHECK(methods.find("muladd2") == 0);
+
+	method_cache cache;
+	int a = 3;
+	long b = 4, r = 0;
+	void *args[] = { &a, &b };
+	BOOST_CHECK(methods.invoke(cache, "muladd", args, &r));
+	BOOST_CHECK_EQUAL(r, 34);
+	r = 0;
+	BOOST_CHECK(methods.invoke(cache, "muladd", args, &r));
+	BOOST_CHECK_EQUAL(r, 34);
+
+	// rebuilding moves the slots, caches fall back to a lookup
+	std::vector< delegate_dynamic<long (int, const long&)> > many(500, muladd);
+	for(size_t i = 0; i != many.size(); ++i)
+		methods.add("method" + std::to_string(i), &many[i]);
+	methods.build();
+	BOOST_CHECK_EQUAL(methods.size(), 502u);
+	BOOST_CHECK(methods.find(cache, "muladd") == &muladd);
+	bool found = true;
+	for(size_t i = 0; i != many.size(); ++i)
+		found = found && methods.find("method" + std::to_string(i)) == &many[i];
+	BOOST_CHECK(found);
+	BOOST_CHECK(methods.find("method500") == 0);
+
+	method_cache missing;
+	BOOST_CHECK(!methods.invoke(missing, "nothing", args, &r));
+}
+
+enum Color : int { Red, Green };
+
+static Test* PickTest(Test *a, long n) { return n ? a : 0; }
+static Named* PickNamed(Named *a, long n) { return n ? 0 : a; }
+static std::string& LastName(Named *a, long) { return a->last; }
+static std::string& LastOf(std::vector<std::string> *a, long) { return a->back(); }
+static std::string NameOf(Named *a, long n) { return a->last.substr(size_t(n)); }
+
+BOOST_AUTO_TEST_CASE( TestAbiSignature )
+{
+	static_assert(std::is_same<abi_signature<Test* (const Named&, long, unsigned)>::type, void* (char&, int64_t, uint32_t)>::value, "pointers, references, integers");
+	static_assert(std::is_same<abi_signature<void (Color, bool, double, std::string)>::type, void (int32_t, bool, double, std::string)>::value, "enums, kept types");
+	static_assert(std::is_same<abi_signature<int (int (*)(int), std::string&&)>::type, int32_t (int (*)(int), char&&)>::value, "function pointers are kept");
+	static_assert(std::is_same<abi_signature<std::string& (Named&, long)>::type, std::string& (char&, int64_t)>::value, "returned references are kept");
+
+	// calls through the shared thunks unpack the original types
+	delegate_dynamic<Test* (Test*, long)> pick_test(&PickTest);
+	delegate_dynamic<Named* (Named*, long)> pick_named(&PickNamed);
+	Test t;
+	Named n;
+	long one = 1, zero = 0;
+	Test *tret = 0;
+	Named *nret = 0;
+	Test *targ = &t;
+	Named *narg = &n;
+	void *targs[] = { &targ, &one };
+	void *nargs[] = { &narg, &zero };
+	pick_test.invoke(targs, &tret);
+	pick_named.invoke(nargs, &nret);
+	BOOST_CHECK(tret == &t);
+	BOOST_CHECK(nret == &n);
+
+	delegate_any a(make_delegate(&PickTest)), b(make_delegate(&PickNamed));
+	tret = 0;
+	a.invoke(targs, &tret);
+	BOOST_CHECK(tret == &t);
+
+	// returned references and classes are stored as their own type
+	n.last = "a long enough name to be allocated";
+	std::vector<std::string> names(1, "another name long enough to be allocated");
+	std::vector<std::string> *varg = &names;
+	void *vargs[] = { &varg, &one };
+	delegate_dynamic<std::string& (Named*, long)> last_name(&LastName);
+	delegate_dynamic<std::string& (std::vector<std::string>*, long)> last_of(&LastOf);
+	delegate_dynamic<std::string (Named*, long)> name_of(&NameOf);
+	std::string sret;
+	last_name.invoke(nargs, &sret);
+	BOOST_CHECK_EQUAL(sret, n.last);
+	last_of.invoke(vargs, &sret);
+	BOOST_CHECK_EQUAL(sret, names[0]);
+	name_of.invoke(nargs, &sret);
+	BOOST_CHECK_EQUAL(sret, n.last);
+
+#if defined(FASTDELEGATE_FOLD_ABI_SIGNATURES)
+	BOOST_CHECK(a.getInvoker() == b.getInvoker());
+	invoker_fold_stats stats = get_invoker_fold_stats();
+	BOOST_CHECK(stats.invokers < stats.signatures);
+#else
+	BOOST_CHECK(a.getInvoker() != b.getInvoker());
+#endif
+}
+
+BOOST_AUTO_TEST_CASE( TestCompileTimeTargets )
+{
+	g_static_hits = 0;
+	delegate<void (int)> s;
+	s.bind<&F2>();
+	s(3);
+	BOOST_CHECK_EQUAL(g_static_hits, 3);
+
+	Counter c;
+	delegate<void (int)> m;
+	m.bind<Counter, &Counter::add>(&c);
+	m(2);
+	m(5);
+	BOOST_CHECK_EQUAL(c.hits, 7);
+
+	// Equal to the same compile-time target only
+	delegate<void (int)> m2;
+	m2.bind<Counter, &Counter::add>(&c);
+	BOOST_CHECK(m == m2);
+	BOOST_CHECK(m != make_delegate(&c, &Counter::add));
+	delegate<void (int)> s2 = s;
+	BOOST_CHECK(s2 == s);
+	BOOST_CHECK(s != m);
+
+	const Wide w;
+	delegate<int (int, int, int, int, int, int, int, const Test&)> cw;
+	cw.bind<Wide, &Wide::sum8>(&w);
+	BOOST_CHECK_EQUAL(cw(1, 2, 3, 4, 5, 6, 7, Test()), 100 + 28 + 357);
+
+	// Non-trivial classes by value
+	delegate<int (CopyCounter)> v;
+	v.bind<&TakeByValue>();
+	CopyCounter cc;
+	CopyCounter::reset();
+	BOOST_CHECK_EQUAL(v(cc), 7);
+	BOOST_CHECK_EQUAL(CopyCounter::copies, 1);
+
+	delegate_dynamic<void (int)> dyn;
+	dyn.bind<Counter, &Counter::add>(&c);
+	int arg = 10;
+	void *args[] = { &arg };
+	dyn.invoke(args, 0);
+	BOOST_CHECK_EQUAL(c.hits, 17);
+
+#if defined(FASTDLGT_HAS_AUTO_TEMPLATE_PARAMS)
+	auto md = make_delegate<&Counter::add>(&c);
+	md(1);
+	BOOST_CHECK_EQUAL(c.hits, 18);
+	BOOST_CHECK(md == m);
+
+	auto sd = make_delegate<&Sum7>();
+	BOOST_CHECK_EQUAL(sd(1, 2, 3, 4, 5, 6, 7), 28);
+	BOOST_CHECK_EQUAL(make_delegate<&Wide::sum8>(&w)(0, 0, 0, 0, 0, 0, 0, Test()), 457);
+
+	auto dd = make_delegate_dynamic<&F2>();
+	dd.invoke(args, 0);
+	BOOST_CHECK_EQUAL(g_static_hits, 13);
+#endif
+}
+
+struct WeakCounter : weak_target
+{
+	int hits;
+	WeakCounter() : hits(0) { }
+	void add(int n) { hits += n; }
+	int get() const { return hits; }
+	int& ref() { return hits; }
+};
+
+BOOST_AUTO_TEST_CASE( TestWeakDelegate )
+{
+	weak_delegate<void (int)> d;
+	weak_delegate<int ()> g;
+	weak_delegate<int& ()> r;
+	BOOST_CHECK(!d.alive());
+	{
+		WeakCounter c;
+		d = make_weak_delegate(&c, &WeakCounter::add);
+		g = make_weak_delegate(&c, &WeakCounter::get);
+		r = make_weak_delegate(&c, &WeakCounter::ref);
+		BOOST_CHECK(d.alive());
+		d(4);
+		BOOST_CHECK_EQUAL(g(), 4);
+		BOOST_CHECK_EQUAL(&r(), &c.hits);
+
+		// Copies are separate targets
+		WeakCounter copy(c);
+		weak_delegate<int ()> cg = make_weak_delegate(&copy, &WeakCounter::get);
+		BOOST_CHECK(cg.ref() != g.ref());
+
+		c.invalidate_weak_refs();
+		BOOST_CHECK(!d.alive());
+		d(1);
+		BOOST_CHECK_EQUAL(c.hits, 4);
+		d = make_weak_delegate(&c, &WeakCounter::add);
+	}
+	// Target destroyed: the call is skipped, the result value-initialized
+	BOOST_CHECK(!d.alive());
+	BOOST_CHECK(d.ref().expired());
+	d(1);
+	BOOST_CHECK_EQUAL(g(), 0);
+	// no reference to return
+	BOOST_CHECK_THROW(r(), std::bad_function_call);
+
+	// The slot gets reused by a new target, old references stay dead
+	WeakCounter c2;
+	BOOST_CHECK(!d.alive());
+
+	// Explicit anchor as a member
+	struct Holder { weak_target anchor; Counter counter; };
+	std::unique_ptr<Holder> h(new Holder);
+	weak_delegate<void (int)> hd(h->anchor, make_delegate(&h->counter, &Counter::add));
+	hd(3);
+	BOOST_CHECK_EQUAL(h->counter.hits, 3);
+	h.reset();
+	hd(3);
+	BOOST_CHECK(!hd.alive());
+}
+
+BOOST_AUTO_TEST_CASE( TestWeakMulticast )
+{
+	g_static_hits = 0;
+	Counter strong;
+	event<void (int)> ev;
+	ev += make_delegate(&strong, &Counter::add);
+	std::unique_ptr<WeakCounter> w1(new WeakCounter), w2(new WeakCounter);
+	ev += make_weak_delegate(w1.get(), &WeakCounter::add);
+	ev += make_weak_delegate(w2.get(), &WeakCounter::add);
+	ev += &F2;
+	BOOST_CHECK_EQUAL(ev.size(), 4u);
+
+	ev(1);
+	BOOST_CHECK_EQUAL(w1->hits, 1);
+	BOOST_CHECK_EQUAL(w2->hits, 1);
+
+	// Dead subscribers are skipped, then dropped on the next change
+	w1.reset();
+	ev(2);
+	BOOST_CHECK_EQUAL(w2->hits, 3);
+	BOOST_CHECK_EQUAL(strong.hits, 3);
+	BOOST_CHECK_EQUAL(ev.size(), 4u);
+	Counter late;
+	ev += make_delegate(&late, &Counter::add);
+	BOOST_CHECK_EQUAL(ev.size(), 4u);
+
+	w2.reset();
+	BOOST_CHECK_EQUAL(ev.purge(), 1u);
+	ev(5);
+	BOOST_CHECK_EQUAL(strong.hits, 8);
+	BOOST_CHECK_EQUAL(late.hits, 5);
+	BOOST_CHECK_EQUAL(g_static_hits, 8);
+
+	// Weak subscribers removed explicitly
+	WeakCounter w3;
+	weak_delegate<void (int)> wd = make_weak_delegate(&w3, &WeakCounter::add);
+	ev += wd;
+	ev -= wd;
+	ev(1);
+	BOOST_CHECK_EQUAL(w3.hits, 0);
+	BOOST_CHECK_EQUAL(ev.size(), 3u);
+}
+
+BOOST_AUTO_TEST_CASE( TestCallStats )
+{
+	Counter c;
+	delegate<void (int)> d(&c, &Counter::add);
+	delegate<void (int)> s(&F2);
+	event<void (int)> ev;
+	ev += s;
+
+	reset_call_stats();
+	for(int i = 0; i != 10; ++i)
+		d(1);
+	ev(1);
+	s(1);
+	call_stats_snapshot snap = snapshot_call_stats();
+	std::string text = format_call_stats(snap);
+	std::string json = format_call_stats_json(snap);
+	BOOST_CHECK(text.find("calls") != std::string::npos);
+	BOOST_CHECK(json.find("\"targets\"") != std::string::npos);
+
+#if defined(FASTDELEGATE_CALL_STATS)
+	const call_target_stats *member = 0, *stat = 0;
+	for(size_t i = 0; i != snap.targets.size(); ++i)
+	{
+		if(snap.targets[i].object() == &c)
+			member = &snap.targets[i];
+		if(snap.targets[i].object() == reinterpret_cast<const void*>(&F2))
+			stat = &snap.targets[i];
+	}
+	BOOST_REQUIRE(member && stat);
+	BOOST_CHECK_EQUAL(member->calls, 10u);
+	BOOST_CHECK_EQUAL(stat->calls, 2u);
+	unsigned long long bucketed = 0;
+	for(size_t i = 0; i != CALL_STATS_BUCKETS; ++i)
+		bucketed += member->histogram[i];
+	BOOST_CHECK_EQUAL(bucketed, 10u);
+	BOOST_CHECK(member->percentile_ns(0.5) <= member->percentile_ns(0.99));
+	BOOST_CHECK(json.find("\"calls\": 10") != std::string::npos);
+
+	reset_call_stats();
+	BOOST_CHECK(snapshot_call_stats().targets.empty());
+	d(1);
+	snap = snapshot_call_stats();
+	BOOST_REQUIRE_EQUAL(snap.targets.size(), 1u);
+	BOOST_CHECK_EQUAL(snap.targets[0].calls, 1u);
+#else
+	BOOST_CHECK(snap.targets.empty());
+#endif
+}
+
+struct TraceCascade
+{
+	delegate<void (int)> inner;
+	void outer(int n) { inner(n); inner(n); }
+};
+
+BOOST_AUTO_TEST_CASE( TestCallTrace )
+{
+	Counter c;
+	TraceCascade cascade;
+	cascade.inner.bind(&c, &Counter::add);
+	delegate<void (int)> outer(&cascade, &TraceCascade::outer);
+
+	clear_call_trace();
+	outer(1);
+	std::vector<call_trace_event> events = collect_call_trace();
+	std::string json = format_chrome_trace(events);
+	BOOST_CHECK(json.find("traceEvents") != std::string::npos);
+
+#if defined(FASTDELEGATE_CALL_TRACE)
+	BOOST_REQUIRE_EQUAL(events.size(), 3u);
+	// Sorted by start, the inner calls lie within the outer one
+	BOOST_CHECK(events[0].object == &cascade);
+	BOOST_CHECK(events[1].object == &c && events[2].object == &c);
+	BOOST_CHECK_EQUAL(events[0].start_us, 0.0);
+	BOOST_CHECK(events[1].start_us <= events[2].start_us);
+	BOOST_CHECK(events[2].start_us + events[2].duration_us <= events[0].duration_us + 0.001);
+	BOOST_CHECK(events[0].thread == events[1].thread);
+	BOOST_CHECK(json.find("\"ph\": \"X\"") != std::string::npos);
+
+	// Other threads get their own rings
+	delegate_executor pool(1);
+	pool.submit(outer, 2).get();
+	events = collect_call_trace();
+	BOOST_CHECK_EQUAL(events.size(), 6u);
+	unsigned other = 0;
+	for(size_t i = 0; i != events.size(); ++i)
+		other += events[i].thread != events[0].thread;
+	BOOST_CHECK_EQUAL(other, 3u);
+
+	enable_call_trace(false);
+	clear_call_trace();
+	outer(1);
+	BOOST_CHECK(collect_call_trace().empty());
+	enable_call_trace(true);
+#else
+	BOOST_CHECK(events.empty());
+#endif
+}
+
+BOOST_AUTO_TEST_CASE( TestSymbols )
+{
+	Counter c;
+	delegate<void (int)> member(&c, &Counter::add);
+	delegate<void (int)> stat(&F2);
+
+	// Cached: the same entry for the same address
+	const code_symbol &m = resolve_target_symbol(member);
+	BOOST_CHECK(&m == &resolve_target_symbol(member));
+	BOOST_CHECK(!m.name.empty());
+
+	// Not code, named after the address
+	int local = 0;
+	const code_symbol &data = resolve_code_symbol(&local);
+	BOOST_CHECK(!data.resolved);
+	BOOST_CHECK(data.name.compare(0, 2, "0x") == 0);
+
+#if defined(__linux__)
+	BOOST_CHECK(m.resolved);
+	BOOST_CHECK(m.name.find("Counter::add") != std::string::npos);
+	BOOST_CHECK(!m.module.empty());
+	// Static functions are found behind the invoker
+	const code_symbol &s = resolve_target_symbol(stat);
+	BOOST_CHECK(s.name.find("F2") != std::string::npos);
+	BOOST_CHECK(s.address == reinterpret_cast<const void*>(&F2));
+	BOOST_CHECK_EQUAL(s.offset, 0u);
+
+#if defined(FASTDELEGATE_CALL_STATS)
+	reset_call_stats();
+	stat(1);
+	BOOST_CHECK(format_call_stats(snapshot_call_stats()).find("F2") != std::string::npos);
+#endif
+#endif
+}
+
+BOOST_AUTO_TEST_CASE( TestEmptySink )
+{
+	delegate<int (int)> none;
+	delegate<int (int)> bound(&Twice);
+	BOOST_CHECK(none.empty() && !none);
+	BOOST_CHECK(none == 0);
+	BOOST_CHECK(none == delegate<int (int)>());
+	BOOST_CHECK(!bound.empty());
+	bound.clear();
+	BOOST_CHECK(bound.empty());
+	BOOST_CHECK(bound == none);
+	delegate<int (int)> copy(none);
+	BOOST_CHECK(copy.empty());
+
+	// Restored from raw closure data which was never bound
+	delegate<int (int)> restored(&Twice);
+	restored.setFunctionData(detail::function_data());
+	BOOST_CHECK(restored.empty());
+
+#if defined(FASTDELEGATE_EMPTY_SINK)
+	// Calls are unconditional, the results value-initialized
+	BOOST_CHECK_EQUAL(none(5), 0);
+	BOOST_CHECK_EQUAL(bound(5), 0);
+	BOOST_CHECK_EQUAL(restored(5), 0);
+	delegate<std::string (const std::string&, Test)> text;
+	BOOST_CHECK(text("x", Test()).empty());
+	delegate<void (CopyCounter)> sink;
+	sink(CopyCounter());
+	int value = 0;
+	delegate<int& (int)> ref;
+	BOOST_CHECK_THROW(ref(value), std::bad_function_call);
+#endif
+}
+
+struct VirtualBase
+{
+	int base;
+	delegate<int (int)> bound_in_ctor;
+	VirtualBase() : base(1) { bound_in_ctor.bind(this, &VirtualBase::value); }
+	virtual ~VirtualBase() { }
+	virtual int value(int n) { return n + base; }
+};
+
+struct VirtualOther
+{
+	int factor;
+	VirtualOther() : factor(100) { }
+	virtual ~VirtualOther() { }
+	virtual int scaled(int n) { return n * factor; }
+};
+
+struct VirtualDerived : VirtualBase, VirtualOther
+{
+	VirtualDerived() { factor = 1000; }
+	virtual int value(int n) { return n + 10; }
+	virtual int scaled(int n) { return n * factor + 1; }
+};
+
+BOOST_AUTO_TEST_CASE( TestVirtualTargets )
+{
+	VirtualDerived obj;
+	VirtualBase *base = &obj;
+	delegate<int (int)> value(base, &VirtualBase::value);
+	delegate<int (int)> scaled(&obj, &VirtualOther::scaled);
+	delegate<int (int)> scaled2(&obj, &VirtualDerived::scaled);
+	BOOST_CHECK_EQUAL(value(1), 11);
+	BOOST_CHECK_EQUAL(scaled(2), 2001);
+	BOOST_CHECK_EQUAL(scaled2(2), 2001);
+	BOOST_CHECK(value == delegate<int (int)>(&obj, &VirtualBase::value));
+
+#if defined(FASTDLGT_RESOLVE_ITANIUM_MFP)
+	// Resolved when bound: a plain code address, 'this' already adjusted.
+	// Code at an odd address (functions aren't aligned without optimization)
+	// is left virtual, the override is then looked up when called.
+	detail::target_id id = scaled.getFunctionData().GetTargetId();
+	detail::target_id ctor_id = obj.bound_in_ctor.getFunctionData().GetTargetId();
+	BOOST_CHECK(id.object == static_cast<VirtualOther*>(&obj));
+	BOOST_CHECK_EQUAL(id.function[1], 0u);
+#if defined(__OPTIMIZE__) && !defined(__OPTIMIZE_SIZE__)
+	BOOST_CHECK_EQUAL(id.function[0] & 1, 0u);
+	BOOST_CHECK_EQUAL(ctor_id.function[0] & 1, 0u);
+#endif
+	// Bound during the base constructor, before the override took effect
+	BOOST_CHECK_EQUAL(obj.bound_in_ctor(1), (ctor_id.function[0] & 1) ? 11 : 2);
+#else
+	BOOST_CHECK_EQUAL(obj.bound_in_ctor(1), 11);
+#endif
+
+#if defined(__linux__)
+	// Named after the override, resolved at bind time or through the object
+	BOOST_CHECK(resolve_target_symbol(value).name.find("VirtualDerived::value") != std::string::npos);
+	BOOST_CHECK(resolve_target_symbol(scaled).name.find("VirtualDerived::scaled") != std::string::npos);
+	BOOST_CHECK(resolve_target_symbol(scaled2).name.find("VirtualDerived::scaled") != std::string::npos);
+
+#if defined(FASTDELEGATE_CALL_STATS)
+	// Named after the override even once the object is gone
+	reset_call_stats();
+	VirtualDerived *gone = new VirtualDerived;
+	delegate<int (int)> dangling(static_cast<VirtualBase*>(gone), &VirtualBase::value);
+	BOOST_CHECK_EQUAL(dangling(1), 11);
+	delete gone;
+	BOOST_CHECK(format_call_stats(snapshot_call_stats()).find("VirtualDerived::value") != std::string::npos);
+#endif
+#endif
+}
+
 BOOST_AUTO_TEST_SUITE_END();